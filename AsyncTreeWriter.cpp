@@ -0,0 +1,131 @@
+#include "AsyncTreeWriter.h"
+
+#include <chrono>
+#include <iostream>
+
+namespace {
+  // How long a thread waits before looking at a queue again
+  const std::chrono::microseconds IDLE_WAIT(50);
+  // How often the writer looks at the size of the baskets
+  const Long64_t BASKET_CHECK_FILLS=100;
+}
+
+AsyncTreeWriter::AsyncTreeWriter() : tree_(nullptr), treeStorage_(nullptr), stopping_(false), fillErrors_(0), zipBytes_(0), basketLimit_(0), basketBytes_(0), pushCount_(0), fillCount_(0), fillSeconds_(0), running_(false)
+{}
+
+AsyncTreeWriter::~AsyncTreeWriter()
+{
+  Drain();
+}
+
+void AsyncTreeWriter::Start(TTree *tree, ValidationEventStorage *treeStorage, const ValidationEventStorage &prototype, size_t queueSize)
+{
+  Drain();
+  tree_=tree;
+  treeStorage_=treeStorage;
+  if (queueSize<1) queueSize=1;
+  filled_.Resize(queueSize);
+  free_.Resize(queueSize);
+  // Every buffer fits in either queue, so pushing never fails
+  buffers_.clear();
+  for (size_t i=0;i<filled_.GetCapacity();++i)
+  {
+    buffers_.emplace_back(new ValidationEventStorage(prototype));
+    free_.TryPush(buffers_.back().get());
+  }
+  stopping_=false;
+  fillErrors_=0;
+  zipBytes_=0;
+  basketBytes_=GetTreeBasketBytes(tree_);
+  pushCount_=0;
+  fillCount_=0;
+  fillSeconds_=0;
+  thread_=std::thread(&AsyncTreeWriter::Run,this);
+  running_=true;
+}
+
+void AsyncTreeWriter::Push(ValidationEventStorage &event)
+{
+  ValidationEventStorage *buffer=nullptr;
+  while (!free_.TryPop(buffer)) std::this_thread::sleep_for(IDLE_WAIT);
+  SwapEventStorage(event,*buffer);
+  filled_.TryPush(buffer);
+  ++pushCount_;
+}
+
+void AsyncTreeWriter::Wait()
+{
+  if (!running_) return;
+  while (fillCount_.load()<pushCount_) std::this_thread::sleep_for(IDLE_WAIT);
+}
+
+void AsyncTreeWriter::Run()
+{
+  ValidationEventStorage *buffer=nullptr;
+  while (true)
+  {
+    if (filled_.TryPop(buffer))
+    {
+      SwapEventStorage(*buffer,*treeStorage_);
+      std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+      if (tree_->Fill()<0) ++fillErrors_;
+      fillSeconds_+=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+      zipBytes_=tree_->GetZipBytes();
+      if ((fillCount_+1)%BASKET_CHECK_FILLS==0)
+      {
+        LimitTreeBaskets(tree_,basketLimit_);
+        basketBytes_=GetTreeBasketBytes(tree_);
+      }
+      ++fillCount_; // Last, so that Wait() returns after the tree is finished with
+      free_.TryPush(buffer);
+      continue;
+    }
+    // Only stop once the queue is empty: stopping_ is set after the last push
+    if (stopping_.load() && filled_.IsEmpty()) return;
+    std::this_thread::sleep_for(IDLE_WAIT);
+  }
+}
+
+void AsyncTreeWriter::Drain()
+{
+  if (!running_) return;
+  stopping_=true;
+  thread_.join();
+  running_=false;
+  if (fillErrors_>0) std::cerr << "The tree writer had " << fillErrors_ << " fill errors" << std::endl;
+}
+
+bool AsyncTreeWriter::IsRunning() const
+{
+  return running_;
+}
+
+Long64_t AsyncTreeWriter::GetFillErrors() const
+{
+  return fillErrors_;
+}
+
+Long64_t AsyncTreeWriter::GetZipBytes() const
+{
+  return zipBytes_;
+}
+
+void AsyncTreeWriter::SetBasketLimit(Long64_t bytes)
+{
+  basketLimit_=bytes;
+}
+
+Long64_t AsyncTreeWriter::GetBasketBytes() const
+{
+  return basketBytes_;
+}
+
+size_t AsyncTreeWriter::GetBufferCount() const
+{
+  return buffers_.size();
+}
+
+double AsyncTreeWriter::GetFillSeconds() const
+{
+  return fillSeconds_;
+}
@@ -0,0 +1,67 @@
+#ifndef ASYNCTREEWRITER_HH
+#define ASYNCTREEWRITER_HH
+#include "TTree.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "SpscQueue.h"
+#include "ValidationEventStorage.h"
+#include "MemoryBudget.h"
+
+// Fills a tree on its own thread, so that compressing and writing baskets doesn't hold up processing.
+// Events are passed over a bounded lock-free queue in a pool of recycled buffers: Push swaps the
+// event's contents into a free buffer (no copying), and the writer swaps them into the storage the
+// tree's branches point at and fills the tree. The events are filled in the order they were pushed,
+// so the tree is the same as if it had been filled directly. Only the writer thread may touch the
+// tree (or its file) between Start and Drain
+class AsyncTreeWriter{
+public:
+  AsyncTreeWriter();
+  ~AsyncTreeWriter();
+  // The tree's branches must point at treeStorage. The buffers are copies of prototype,
+  // so that they have the same number of calorimeter bands
+  void Start(TTree *tree, ValidationEventStorage *treeStorage, const ValidationEventStorage &prototype, size_t queueSize);
+  // Hand over an event. Its contents are swapped for a recycled buffer's, so clear it before reuse.
+  // Waits if the writer is a whole queue behind
+  void Push(ValidationEventStorage &event);
+  // Wait until every event pushed so far has been filled. The thread keeps running, but doesn't
+  // touch the tree again until the next Push, so the tree can be saved in between
+  void Wait();
+  // Wait until every event has been filled, then stop the thread
+  void Drain();
+  bool IsRunning() const;
+  Long64_t GetFillErrors() const;
+  // Compressed bytes the tree has written so far, as of the last event filled. Safe to call while running
+  Long64_t GetZipBytes() const;
+  // Keep the tree's baskets within this many bytes (see LimitTreeBaskets), if more than 0
+  void SetBasketLimit(Long64_t bytes);
+  // Size of the tree's baskets, as of the last check. Safe to call while running
+  Long64_t GetBasketBytes() const;
+  size_t GetBufferCount() const;
+  // Time the writer thread has spent filling the tree. Only valid after Drain
+  double GetFillSeconds() const;
+
+private:
+  TTree *tree_;
+  ValidationEventStorage *treeStorage_;
+  std::vector<std::unique_ptr<ValidationEventStorage> > buffers_;
+  SpscQueue<ValidationEventStorage*> filled_; // Processing thread to writer
+  SpscQueue<ValidationEventStorage*> free_; // Writer back to processing thread
+  std::thread thread_;
+  std::atomic<bool> stopping_;
+  std::atomic<Long64_t> fillErrors_;
+  std::atomic<Long64_t> zipBytes_;
+  std::atomic<Long64_t> basketLimit_;
+  std::atomic<Long64_t> basketBytes_;
+  Long64_t pushCount_; // Only touched by the processing thread
+  std::atomic<Long64_t> fillCount_;
+  double fillSeconds_; // Only touched by the writer thread until it is joined
+  bool running_;
+
+  void Run(); // The writer thread
+};
+
+#endif // ASYNCTREEWRITER_HH
@@ -0,0 +1,77 @@
+#include "CaloHitSummary.h"
+#include "TMath.h"
+
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+void SummarizeCaloHits(const snemo::datamodel::calibrated_data::calorimeter_hit_collection_type &calHits, CaloHitSummary &summary)
+{
+  summary.energy_=0;
+  summary.mainwallEnergy_=0;
+  summary.xwallEnergy_=0;
+  summary.vetoEnergy_=0;
+  summary.energyOverThreshold_=0;
+  summary.firstHitTime_=-1.;
+  summary.firstHitTimeSigma_=0;
+  summary.firstHitType_=0;
+  summary.firstHitIndex_=-1;
+  summary.encodedIds_.clear();
+  double energySigmaSq=0;
+
+  for (unsigned int hit=0; hit<calHits.size();++hit)
+  {
+    const snemo::datamodel::calibrated_calorimeter_hit & calo_hit = calHits.at(hit).get();
+    double thisHitEnergy=calo_hit.get_energy();
+
+    // Sum the energies
+    summary.energy_ += thisHitEnergy;
+    energySigmaSq += calo_hit.get_sigma_energy()*calo_hit.get_sigma_energy(); // Add in quadrature
+    if (thisHitEnergy > LOW_ENERGY_LIMIT) summary.energyOverThreshold_ += thisHitEnergy;
+
+    // We want to know how much of the energy was deposited in each calo wall
+    int hitType=calo_hit.get_geom_id().get_type();
+    if (hitType==CALO_MAINWALL)
+      summary.mainwallEnergy_+= thisHitEnergy;
+    else if (hitType==CALO_XWALL)
+      summary.xwallEnergy_+= thisHitEnergy;
+    else if (hitType==CALO_GVETO)
+      summary.vetoEnergy_+= thisHitEnergy;
+    else cout<<"WARNING: Unknown calorimeter type "<<hitType<<endl;
+
+    // Find the hit with the earliest time
+    if (summary.firstHitTime_==-1 || calo_hit.get_time()<summary.firstHitTime_)
+    {
+      summary.firstHitTime_=calo_hit.get_time();
+      summary.firstHitType_=hitType; // Which calo wall it hit first
+      summary.firstHitTimeSigma_= calo_hit.get_sigma_time(); // We need the uncertainty in the first hit time
+      summary.firstHitIndex_=hit;
+    }
+
+    summary.encodedIds_.push_back(EncodeCaloLocation(calo_hit));
+  }
+  summary.energySigma_=TMath::Sqrt(energySigmaSq);
+}
+
+int EncodeCaloLocation(const geomtools::geom_id & gid)
+{
+  if (gid.get_depth() < 4) return CALO_INVALID_LOCATION;
+  // The X-wall is the only type that needs the fifth address (row); the others have the part number there.
+  // An X-wall ID without a row can't be placed, so it is invalid rather than put in row 0
+  if (gid.get_type() == CALO_XWALL && gid.get_depth() < 5) return CALO_INVALID_LOCATION;
+  int address4=(gid.get_depth() > 4 ? gid.get(4) : 0);
+  return CaloEncodeAddress(gid.get_type(), gid.get(1), gid.get(2), gid.get(3), address4);
+}
+
+int EncodeCaloLocation(const snemo::datamodel::calibrated_calorimeter_hit & hit)
+{
+  return EncodeCaloLocation(hit.get_geom_id());
+}
+
+string EncodeCaloLocationString(const snemo::datamodel::calibrated_calorimeter_hit & hit)
+{ // Returns the geomID as a string ready for decoding
+  std::stringstream buffer;
+  buffer << hit.get_geom_id();
+  return buffer.str();
+}
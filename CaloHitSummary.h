@@ -0,0 +1,38 @@
+#ifndef CALOHITSUMMARY_HH
+#define CALOHITSUMMARY_HH
+// - Falaise
+#include "falaise/snemo/datamodels/calibrated_data.h"
+
+#include <string>
+#include <vector>
+
+#include "CaloLocation.h"
+
+const double LOW_ENERGY_LIMIT=0.050; // 50 keV
+
+// Everything we want to know about a collection of calorimeter hits (for example the ones
+// associated to a track), collected in a single pass over the hits
+struct CaloHitSummary{
+  double energy_=0;
+  double energySigma_=0; // Hit uncertainties added in quadrature
+  double mainwallEnergy_=0;
+  double xwallEnergy_=0;
+  double vetoEnergy_=0;
+  double energyOverThreshold_=0; // Only hits over LOW_ENERGY_LIMIT
+  double firstHitTime_=-1.;
+  double firstHitTimeSigma_=0;
+  int firstHitType_=0; // Which wall was hit first
+  int firstHitIndex_=-1; // Position of the earliest hit in the collection
+  std::vector<int> encodedIds_; // In the same order as the hits, see CaloLocation.h
+};
+
+// Fill the summary from the hits. The summary is cleared first, so it can be reused
+void SummarizeCaloHits(const snemo::datamodel::calibrated_data::calorimeter_hit_collection_type &calHits, CaloHitSummary &summary);
+
+// Returns the location of the hit encoded as in CaloLocation.h
+int EncodeCaloLocation(const geomtools::geom_id & gid);
+int EncodeCaloLocation(const snemo::datamodel::calibrated_calorimeter_hit & hit);
+// Returns the geomID as a string ready for decoding: the old encoding, kept for compatibility
+std::string EncodeCaloLocationString(const snemo::datamodel::calibrated_calorimeter_hit & hit);
+
+#endif // CALOHITSUMMARY_HH
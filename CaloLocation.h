@@ -0,0 +1,119 @@
+//! \file    CaloLocation.h
+//! \brief   Integer encoding of calorimeter block locations
+//! \details Header only, with no Falaise dependencies, so that the parser can use it too
+#ifndef CALOLOCATION_HH
+#define CALOLOCATION_HH
+
+// The encoded location is a 7 digit number TSWCCRR:
+//   T  = wall type: 1 for the main wall, 2 for the X-wall, 3 for the gamma veto
+//   S  = side: 0 Italy, 1 France
+//   W  = wall: for the X-wall 0 mountain, 1 tunnel; for the gamma veto 0 bottom, 1 top; 0 for the main wall
+//   CC = column: main wall 0-19, X-wall 0-1, gamma veto 0-15
+//   RR = row: main wall 0-12, X-wall 0-15, 0 for the gamma veto
+// For example 1101203 is main wall, France side, column 12, row 3
+// Anything that isn't a calorimeter block is encoded as CALO_INVALID_LOCATION
+
+// geom_id types of the calorimeter blocks
+const int CALO_MAINWALL=1302; // [module.side.column.row.part]
+const int CALO_XWALL=1232; // [module.side.wall.column.row.part]
+const int CALO_GVETO=1252; // [module.side.wall.column.part]
+
+const int CALO_INVALID_LOCATION=-1;
+
+// Sizes of each calorimeter wall
+const int CALO_MAINWALL_COLUMNS=20;
+const int CALO_MAINWALL_ROWS=13;
+const int CALO_XWALL_COLUMNS=2;
+const int CALO_XWALL_ROWS=16;
+const int CALO_GVETO_COLUMNS=16;
+
+// Every block has a dense index from 0 to CALO_BLOCK_COUNT-1, for lookup tables:
+// main wall blocks first, then X-wall, then gamma veto
+const int CALO_MAINWALL_BLOCKS=2 * CALO_MAINWALL_COLUMNS * CALO_MAINWALL_ROWS;
+const int CALO_XWALL_BLOCKS=2 * 2 * CALO_XWALL_COLUMNS * CALO_XWALL_ROWS;
+const int CALO_GVETO_BLOCKS=2 * 2 * CALO_GVETO_COLUMNS;
+const int CALO_BLOCK_COUNT=CALO_MAINWALL_BLOCKS + CALO_XWALL_BLOCKS + CALO_GVETO_BLOCKS;
+
+// Wall type digit from a geom_id type, or 0 if it isn't a calorimeter
+constexpr int CaloWallTypeIndex(int geomType)
+{
+  return (geomType==CALO_MAINWALL ? 1 : (geomType==CALO_XWALL ? 2 : (geomType==CALO_GVETO ? 3 : 0)));
+}
+
+constexpr int CaloEncode(int typeIndex, int side, int wall, int column, int row)
+{
+  return typeIndex * 1000000 + side * 100000 + wall * 10000 + column * 100 + row;
+}
+
+// Decoding: each of these assumes a valid location
+constexpr int CaloDecodeTypeIndex(int location) { return location / 1000000; }
+constexpr int CaloDecodeSide(int location) { return (location / 100000) % 10; }
+constexpr int CaloDecodeWall(int location) { return (location / 10000) % 10; }
+constexpr int CaloDecodeColumn(int location) { return (location / 100) % 100; }
+constexpr int CaloDecodeRow(int location) { return location % 100; }
+constexpr int CaloDecodeGeomType(int location)
+{
+  return (CaloDecodeTypeIndex(location)==1 ? CALO_MAINWALL : (CaloDecodeTypeIndex(location)==2 ? CALO_XWALL : CALO_GVETO));
+}
+
+constexpr bool CaloIsValid(int location)
+{
+  return (location >= 0
+          && CaloDecodeSide(location) < 2
+          && (CaloDecodeTypeIndex(location)==1 ?
+              (CaloDecodeWall(location)==0 && CaloDecodeColumn(location) < CALO_MAINWALL_COLUMNS && CaloDecodeRow(location) < CALO_MAINWALL_ROWS)
+              : CaloDecodeTypeIndex(location)==2 ?
+              (CaloDecodeWall(location) < 2 && CaloDecodeColumn(location) < CALO_XWALL_COLUMNS && CaloDecodeRow(location) < CALO_XWALL_ROWS)
+              : CaloDecodeTypeIndex(location)==3 ?
+              (CaloDecodeWall(location) < 2 && CaloDecodeColumn(location) < CALO_GVETO_COLUMNS && CaloDecodeRow(location)==0)
+              : false));
+}
+
+// Encode from the geom_id type and the addresses that follow the module number
+// (address1 to address4 are geom_id.get(1) to geom_id.get(4); any that don't apply are ignored)
+constexpr int CaloEncodeAddress(int geomType, int address1, int address2, int address3, int address4)
+{
+  return (geomType==CALO_MAINWALL ? CaloEncode(1, address1, 0, address2, address3)
+          : geomType==CALO_XWALL ? CaloEncode(2, address1, address2, address3, address4)
+          : geomType==CALO_GVETO ? CaloEncode(3, address1, address2, address3, 0)
+          : CALO_INVALID_LOCATION);
+}
+
+// Dense index from 0 to CALO_BLOCK_COUNT-1, or -1 for an invalid location
+constexpr int CaloDenseIndex(int location)
+{
+  return (!CaloIsValid(location) ? -1
+          : CaloDecodeTypeIndex(location)==1 ?
+            (CaloDecodeSide(location) * CALO_MAINWALL_COLUMNS + CaloDecodeColumn(location)) * CALO_MAINWALL_ROWS + CaloDecodeRow(location)
+          : CaloDecodeTypeIndex(location)==2 ?
+            CALO_MAINWALL_BLOCKS
+            + ((CaloDecodeSide(location) * 2 + CaloDecodeWall(location)) * CALO_XWALL_COLUMNS + CaloDecodeColumn(location)) * CALO_XWALL_ROWS + CaloDecodeRow(location)
+          : CALO_MAINWALL_BLOCKS + CALO_XWALL_BLOCKS
+            + (CaloDecodeSide(location) * 2 + CaloDecodeWall(location)) * CALO_GVETO_COLUMNS + CaloDecodeColumn(location));
+}
+
+// The inverse of CaloDenseIndex
+constexpr int CaloLocationFromDenseIndex(int index)
+{
+  return (index < 0 || index >= CALO_BLOCK_COUNT ? CALO_INVALID_LOCATION
+          : index < CALO_MAINWALL_BLOCKS ?
+            CaloEncode(1, index / (CALO_MAINWALL_COLUMNS * CALO_MAINWALL_ROWS), 0,
+                       (index / CALO_MAINWALL_ROWS) % CALO_MAINWALL_COLUMNS, index % CALO_MAINWALL_ROWS)
+          : index < CALO_MAINWALL_BLOCKS + CALO_XWALL_BLOCKS ?
+            CaloEncode(2, (index - CALO_MAINWALL_BLOCKS) / (2 * CALO_XWALL_COLUMNS * CALO_XWALL_ROWS),
+                       ((index - CALO_MAINWALL_BLOCKS) / (CALO_XWALL_COLUMNS * CALO_XWALL_ROWS)) % 2,
+                       ((index - CALO_MAINWALL_BLOCKS) / CALO_XWALL_ROWS) % CALO_XWALL_COLUMNS,
+                       (index - CALO_MAINWALL_BLOCKS) % CALO_XWALL_ROWS)
+          : CaloEncode(3, (index - CALO_MAINWALL_BLOCKS - CALO_XWALL_BLOCKS) / (2 * CALO_GVETO_COLUMNS),
+                       ((index - CALO_MAINWALL_BLOCKS - CALO_XWALL_BLOCKS) / CALO_GVETO_COLUMNS) % 2,
+                       (index - CALO_MAINWALL_BLOCKS - CALO_XWALL_BLOCKS) % CALO_GVETO_COLUMNS, 0));
+}
+
+// Checks that the encoding round trips at compile time
+static_assert(CaloEncodeAddress(CALO_MAINWALL, 1, 12, 3, 0)==1101203, "Main wall encoding");
+static_assert(CaloDenseIndex(CaloLocationFromDenseIndex(0))==0, "First dense index");
+static_assert(CaloDenseIndex(CaloLocationFromDenseIndex(CALO_MAINWALL_BLOCKS + 77))==CALO_MAINWALL_BLOCKS + 77, "X-wall dense index");
+static_assert(CaloDenseIndex(CaloLocationFromDenseIndex(CALO_BLOCK_COUNT - 1))==CALO_BLOCK_COUNT - 1, "Last dense index");
+static_assert(CaloDenseIndex(CaloEncode(4, 0, 0, 0, 0))==-1, "Invalid type");
+
+#endif // CALOLOCATION_HH
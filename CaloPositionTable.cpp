@@ -0,0 +1,140 @@
+#include "CaloPositionTable.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+CaloPositionTable::CaloPositionTable()
+{
+  Clear();
+}
+
+void CaloPositionTable::Clear()
+{
+  x_.assign(CALO_BLOCK_COUNT,0);
+  y_.assign(CALO_BLOCK_COUNT,0);
+  z_.assign(CALO_BLOCK_COUNT,0);
+  known_.assign(CALO_BLOCK_COUNT,0);
+  setupLabel_="";
+  setupVersion_="";
+  filled_=false;
+}
+
+void CaloPositionTable::Build(const geomtools::manager* geometry_manager)
+{
+  Clear();
+  if (!geometry_manager) return;
+  setupLabel_=geometry_manager->get_setup_label();
+  setupVersion_=geometry_manager->get_setup_version();
+  const geomtools::mapping & the_mapping = geometry_manager->get_mapping();
+  for (int index=0;index<CALO_BLOCK_COUNT;++index)
+  {
+    int location=CaloLocationFromDenseIndex(index);
+    // Make the same geom_id as a calibrated hit in this block would have (the part is not specified)
+    geomtools::geom_id gid;
+    const uint32_t module=0;
+    const uint32_t anyPart=geomtools::geom_id::ANY_ADDRESS;
+    switch (CaloDecodeGeomType(location))
+    {
+      case CALO_MAINWALL:
+        gid=geomtools::geom_id(CALO_MAINWALL, module, CaloDecodeSide(location), CaloDecodeColumn(location), CaloDecodeRow(location), anyPart);
+        break;
+      case CALO_XWALL:
+        gid=geomtools::geom_id(CALO_XWALL, module, CaloDecodeSide(location), CaloDecodeWall(location), CaloDecodeColumn(location), CaloDecodeRow(location), anyPart);
+        break;
+      default:
+        gid=geomtools::geom_id(CALO_GVETO, module, CaloDecodeSide(location), CaloDecodeWall(location), CaloDecodeColumn(location), anyPart);
+    }
+    try {
+      geomtools::vector_3d loc (0,0,0);
+      // This is the same lookup that PTD2root does
+      if (! the_mapping.validate_id(gid)) {
+        std::vector<geomtools::geom_id> gids;
+        the_mapping.compute_matching_geom_id(gid, gids); // front calo block = last entry
+        if (gids.empty()) continue; // Not in this geometry
+        const geomtools::geom_info & info = the_mapping.get_geom_info(gids.back()); // in vector gids
+        loc  = info.get_world_placement().get_translation();
+      }
+      else {
+        const geomtools::geom_info & info = the_mapping.get_geom_info(gid);
+        loc  = info.get_world_placement().get_translation();
+      }
+      x_[index]=loc.x();
+      y_[index]=loc.y();
+      z_[index]=loc.z();
+      known_[index]=1;
+    } catch (std::logic_error& e) {
+      // Not in this geometry, so leave it unknown
+    }
+  }
+  filled_=true;
+}
+
+// The file is text: a header line with the geometry setup, then one line per known block:
+// dense index, encoded location, x, y, z
+void CaloPositionTable::Save(const std::string &filename) const
+{
+  std::ofstream output(filename.c_str());
+  if (!output)
+  {
+    std::cerr << "Could not write calorimeter position table to " << filename << std::endl;
+    return;
+  }
+  output.precision(17);
+  output << "CaloPositionTable " << setupLabel_ << " " << setupVersion_ << " " << CALO_BLOCK_COUNT << std::endl;
+  for (int index=0;index<CALO_BLOCK_COUNT;++index)
+  {
+    if (!known_[index]) continue;
+    output << index << " " << CaloLocationFromDenseIndex(index) << " " << x_[index] << " " << y_[index] << " " << z_[index] << std::endl;
+  }
+}
+
+bool CaloPositionTable::Load(const std::string &filename, const std::string &setupLabel, const std::string &setupVersion)
+{
+  Clear();
+  std::ifstream input(filename.c_str());
+  if (!input) return false;
+  std::string header;
+  std::getline(input,header);
+  std::istringstream headerStream(header);
+  std::string tag;
+  int blockCount=0;
+  headerStream >> tag >> setupLabel_ >> setupVersion_ >> blockCount;
+  if (tag!="CaloPositionTable" || setupLabel_!=setupLabel || setupVersion_!=setupVersion || blockCount!=CALO_BLOCK_COUNT)
+  {
+    Clear();
+    return false;
+  }
+  int index;
+  int location;
+  double x, y, z;
+  while (input >> index >> location >> x >> y >> z)
+  {
+    if (index<0 || index>=CALO_BLOCK_COUNT || CaloLocationFromDenseIndex(index)!=location)
+    {
+      Clear();
+      return false;
+    }
+    x_[index]=x;
+    y_[index]=y;
+    z_[index]=z;
+    known_[index]=1;
+  }
+  filled_=true;
+  return true;
+}
+
+bool CaloPositionTable::IsFilled() const
+{
+  return filled_;
+}
+
+bool CaloPositionTable::GetPosition(int location, double &x, double &y, double &z) const
+{
+  int index=CaloDenseIndex(location);
+  if (index<0 || !known_[index]) return false;
+  x=x_[index];
+  y=y_[index];
+  z=z_[index];
+  return true;
+}
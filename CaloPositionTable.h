@@ -0,0 +1,39 @@
+#ifndef CALOPOSITIONTABLE_HH
+#define CALOPOSITIONTABLE_HH
+// - Bayeux
+#include "bayeux/geomtools/manager.h"
+
+#include <string>
+#include <vector>
+
+#include "CaloLocation.h"
+
+// World position of every calorimeter block (main wall, X-wall and gamma veto), indexed by the
+// dense calorimeter index from CaloLocation.h, so that looking up a block is an array read.
+// Build it once from the geometry manager, or load a copy that was saved by an earlier job
+class CaloPositionTable{
+public:
+  CaloPositionTable();
+  // Look up every block in the geometry mapping
+  void Build(const geomtools::manager* geometry_manager);
+  // Read a table written by Save. Returns false (and leaves the table empty) if the file
+  // doesn't exist or was made with a different geometry setup
+  bool Load(const std::string &filename, const std::string &setupLabel, const std::string &setupVersion);
+  void Save(const std::string &filename) const;
+  void Clear();
+
+  bool IsFilled() const;
+  // Get the position of a block from its encoded location. Returns false if we don't know it
+  bool GetPosition(int location, double &x, double &y, double &z) const;
+
+private:
+  std::vector<double> x_;
+  std::vector<double> y_;
+  std::vector<double> z_;
+  std::vector<char> known_; // Did we find this block in the geometry?
+  std::string setupLabel_;
+  std::string setupVersion_;
+  bool filled_;
+};
+
+#endif // CALOPOSITIONTABLE_HH
@@ -0,0 +1,255 @@
+#include "ChannelRateMonitor.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "CaloLocation.h"
+#include "TrackerLocation.h"
+
+ChannelRateMonitor::ChannelRateMonitor() : channelCount_(0), denseIndex_(nullptr), locationFromIndex_(nullptr),
+  eventCount_(0), eventsInWindow_(0), historySlot_(0), historyFilled_(0)
+{}
+
+void ChannelRateMonitor::Initialize(const std::string &mapName, int channelCount, DenseIndexFunction denseIndex,
+                                    LocationFunction locationFromIndex, const std::vector<std::vector<int> > &neighbours,
+                                    const RateMonitorSettings &settings)
+{
+  mapName_=mapName;
+  channelCount_=channelCount;
+  denseIndex_=denseIndex;
+  locationFromIndex_=locationFromIndex;
+  neighbours_=neighbours;
+  neighbours_.resize(channelCount);
+  settings_=settings;
+  settings_.windowEvents_=std::max(1,settings_.windowEvents_);
+  settings_.historyWindows_=std::max(1,settings_.historyWindows_);
+
+  eventCount_=0;
+  eventsInWindow_=0;
+  windowCounts_.assign(channelCount,0);
+  history_.assign(channelCount * settings_.historyWindows_,0);
+  historyTotals_.assign(channelCount,0);
+  historyWindowCounts_.assign(channelCount,0);
+  historySlot_=0;
+  historyFilled_=0;
+  state_.assign(channelCount,NORMAL);
+  openFlag_.assign(channelCount,-1);
+  flagged_.clear();
+}
+
+void ChannelRateMonitor::Fill(const std::vector<int> &locations)
+{
+  for (size_t hit=0;hit<locations.size();++hit)
+  {
+    int index=denseIndex_(locations[hit]);
+    if (index>=0) ++windowCounts_[index];
+  }
+  ++eventCount_;
+  if (++eventsInWindow_>=settings_.windowEvents_) CheckWindow();
+}
+
+// Is this many hits in a window hot or dead, compared with a reference rate in hits per event?
+int ChannelRateMonitor::JudgeRate(int count, double referenceRate) const
+{
+  double expected=referenceRate * eventsInWindow_;
+  if (expected<=0) return NORMAL; // No reference to compare with
+  if (count >= settings_.minHits_ && count > settings_.hotFactor_ * expected) return HOT;
+  if (expected >= settings_.minHits_ && count < settings_.deadFactor_ * expected) return DEAD;
+  return NORMAL;
+}
+
+// Median hits in the current window over a channel's neighbours
+double ChannelRateMonitor::GetNeighbourMedian(const std::vector<int> &neighbours)
+{
+  neighbourCounts_.clear();
+  for (size_t i=0;i<neighbours.size();++i) neighbourCounts_.push_back(windowCounts_[neighbours[i]]);
+  size_t middle=neighbourCounts_.size()/2;
+  std::nth_element(neighbourCounts_.begin(),neighbourCounts_.begin()+middle,neighbourCounts_.end());
+  double median=neighbourCounts_[middle];
+  if (neighbourCounts_.size()%2==0)
+  {
+    // The other middle value is the largest of the lower half
+    median=(median+*std::max_element(neighbourCounts_.begin(),neighbourCounts_.begin()+middle))/2;
+  }
+  return median;
+}
+
+void ChannelRateMonitor::CheckWindow()
+{
+  const Long64_t windowStart=eventCount_-eventsInWindow_;
+  const Long64_t windowEnd=eventCount_-1;
+  for (int channel=0;channel<channelCount_;++channel)
+  {
+    const int count=windowCounts_[channel];
+    int flag=NORMAL;
+    int reasons=0;
+    double referenceRate=0;
+
+    // Compare with the neighbours in this window
+    const std::vector<int> &neighbours=neighbours_[channel];
+    if (!neighbours.empty())
+    {
+      double neighbourRate=GetNeighbourMedian(neighbours) / eventsInWindow_;
+      flag=JudgeRate(count,neighbourRate);
+      if (flag!=NORMAL)
+      {
+        reasons|=NEIGHBOURS;
+        referenceRate=neighbourRate;
+      }
+    }
+    // Compare with its own history
+    if (historyWindowCounts_[channel]>0)
+    {
+      double historyRate=(double)historyTotals_[channel] / ((Long64_t)historyWindowCounts_[channel] * settings_.windowEvents_);
+      int historyFlag=JudgeRate(count,historyRate);
+      if (historyFlag!=NORMAL && (flag==NORMAL || flag==historyFlag))
+      {
+        if (flag==NORMAL) referenceRate=historyRate;
+        flag=historyFlag;
+        reasons|=HISTORY;
+      }
+    }
+
+    double rate=(double)count / eventsInWindow_;
+    if (flag!=state_[channel])
+    {
+      openFlag_[channel]=-1; // Any open flag ended with the previous window
+      if (flag!=NORMAL)
+      {
+        FlaggedChannel flagged;
+        flagged.location_=locationFromIndex_(channel);
+        flagged.flag_=flag;
+        flagged.reasons_=reasons;
+        flagged.firstEvent_=windowStart;
+        flagged.lastEvent_=windowEnd;
+        flagged.rate_=rate;
+        flagged.referenceRate_=referenceRate;
+        flagged.windows_=1;
+        openFlag_[channel]=flagged_.size();
+        flagged_.push_back(flagged);
+        std::cout << mapName_ << " channel " << flagged.location_ << (flag==HOT ? " is hot" : " is dead")
+                  << " in events " << windowStart << " to " << windowEnd << ": " << rate
+                  << " hits per event, expected " << referenceRate << std::endl;
+      }
+      state_[channel]=flag;
+    }
+    else if (flag!=NORMAL)
+    {
+      FlaggedChannel &flagged=flagged_[openFlag_[channel]];
+      flagged.lastEvent_=windowEnd;
+      flagged.reasons_|=reasons;
+      flagged.rate_=(flagged.rate_ * flagged.windows_ + rate)/(flagged.windows_ + 1);
+      flagged.referenceRate_=(flagged.referenceRate_ * flagged.windows_ + referenceRate)/(flagged.windows_ + 1);
+      ++flagged.windows_;
+    }
+  }
+
+  // Put this window in the ring buffer, replacing the oldest once it's full
+  int *slot=&history_[historySlot_ * channelCount_];
+  for (int channel=0;channel<channelCount_;++channel)
+  {
+    if (historyFilled_==settings_.historyWindows_ && slot[channel]>=0)
+    {
+      historyTotals_[channel]-=slot[channel];
+      --historyWindowCounts_[channel];
+    }
+    if (state_[channel]==NORMAL)
+    {
+      historyTotals_[channel]+=windowCounts_[channel];
+      ++historyWindowCounts_[channel];
+      slot[channel]=windowCounts_[channel];
+    }
+    else slot[channel]=-1;
+  }
+  historySlot_=(historySlot_ + 1) % settings_.historyWindows_;
+  historyFilled_=std::min(historyFilled_ + 1, settings_.historyWindows_);
+
+  std::fill(windowCounts_.begin(),windowCounts_.end(),0);
+  eventsInWindow_=0;
+}
+
+// A partial window at the end is too short to judge, so flags just end at the last full window
+void ChannelRateMonitor::Finish()
+{
+  std::fill(openFlag_.begin(),openFlag_.end(),-1);
+  std::fill(state_.begin(),state_.end(),(int)NORMAL);
+}
+
+const std::vector<ChannelRateMonitor::FlaggedChannel>& ChannelRateMonitor::GetFlaggedChannels() const
+{
+  return flagged_;
+}
+
+const std::string& ChannelRateMonitor::GetMapName() const
+{
+  return mapName_;
+}
+
+void ChannelRateMonitor::Write(TDirectory *directory, const std::vector<const ChannelRateMonitor*> &monitors)
+{
+  directory->cd();
+  TTree *tree = new TTree("FlaggedChannels","Hot and dead channels");
+  tree->SetDirectory(directory);
+  std::string map;
+  FlaggedChannel flagged;
+  tree->Branch("map",&map);
+  tree->Branch("location",&flagged.location_);
+  tree->Branch("flag",&flagged.flag_); // 1 hot, 2 dead
+  tree->Branch("reasons",&flagged.reasons_); // 1 neighbours, 2 history, 3 both
+  tree->Branch("first_event",&flagged.firstEvent_);
+  tree->Branch("last_event",&flagged.lastEvent_);
+  tree->Branch("rate",&flagged.rate_);
+  tree->Branch("reference_rate",&flagged.referenceRate_);
+  tree->Branch("windows",&flagged.windows_);
+  for (size_t monitor=0;monitor<monitors.size();++monitor)
+  {
+    map=monitors[monitor]->GetMapName();
+    const std::vector<FlaggedChannel> &flags=monitors[monitor]->GetFlaggedChannels();
+    for (size_t i=0;i<flags.size();++i)
+    {
+      flagged=flags[i];
+      tree->Fill();
+    }
+  }
+  tree->Write();
+  delete tree;
+}
+
+std::vector<std::vector<int> > ChannelRateMonitor::TrackerNeighbours()
+{
+  std::vector<std::vector<int> > neighbours(TRACKER_CELL_COUNT);
+  for (int index=0;index<TRACKER_CELL_COUNT;++index)
+  {
+    int location=TrackerLocationFromDenseIndex(index);
+    int side=TrackerDecodeSide(location);
+    for (int layer=TrackerDecodeLayer(location)-1;layer<=TrackerDecodeLayer(location)+1;++layer)
+    {
+      for (int row=TrackerDecodeRow(location)-1;row<=TrackerDecodeRow(location)+1;++row)
+      {
+        if (layer<0 || layer>=TRACKER_LAYERS || row<0 || row>=TRACKER_ROWS) continue;
+        int neighbour=TrackerDenseIndex(TrackerEncode(side,layer,row));
+        if (neighbour!=index) neighbours[index].push_back(neighbour);
+      }
+    }
+  }
+  return neighbours;
+}
+
+std::vector<std::vector<int> > ChannelRateMonitor::CaloNeighbours()
+{
+  std::vector<std::vector<int> > neighbours(CALO_BLOCK_COUNT);
+  for (int index=0;index<CALO_BLOCK_COUNT;++index)
+  {
+    int location=CaloLocationFromDenseIndex(index);
+    for (int column=CaloDecodeColumn(location)-1;column<=CaloDecodeColumn(location)+1;++column)
+    {
+      for (int row=CaloDecodeRow(location)-1;row<=CaloDecodeRow(location)+1;++row)
+      {
+        if (column<0 || row<0) continue;
+        int neighbour=CaloDenseIndex(CaloEncode(CaloDecodeTypeIndex(location),CaloDecodeSide(location),CaloDecodeWall(location),column,row));
+        if (neighbour>=0 && neighbour!=index) neighbours[index].push_back(neighbour);
+      }
+    }
+  }
+  return neighbours;
+}
@@ -0,0 +1,93 @@
+#ifndef CHANNELRATEMONITOR_HH
+#define CHANNELRATEMONITOR_HH
+#include "TDirectory.h"
+#include "TTree.h"
+
+#include <string>
+#include <vector>
+
+// Settings shared by all the channel monitors
+struct RateMonitorSettings{
+  int windowEvents_=1000; // Rates are counted over windows of this many events
+  int historyWindows_=10; // A channel's own history is its rate over this many previous windows
+  double hotFactor_=5; // Hot if the rate is more than this times the reference rate
+  double deadFactor_=0.2; // Dead if the rate is less than this times the reference rate
+  double minHits_=10; // Don't judge a channel unless it (if hot) or its reference (if dead) has this many hits in a window
+};
+
+// Watches the hit rate in every channel of one detector map (tracker cells or calorimeter blocks)
+// while the job runs, to find hot and dead channels without waiting for the end of the run.
+// Hits are counted in windows of events. At the end of each window, every channel's rate is
+// compared to the median rate of its neighbours in that window (so one hot neighbour doesn't make
+// the others look dead), and to its own rate over the previous windows, which are kept in a ring buffer. Channels outside the band are flagged,
+// and a flag lasts, with its range of events, until the channel is back inside the band.
+// Windows in which a channel was flagged are left out of its history, so that a bad period
+// doesn't become the reference for the channel's normal rate.
+// Everything is in flat arrays indexed by the dense index of the location
+class ChannelRateMonitor{
+public:
+  typedef int (*DenseIndexFunction)(int location);
+  typedef int (*LocationFunction)(int denseIndex);
+  enum Flag { NORMAL=0, HOT=1, DEAD=2 };
+  enum Reason { NEIGHBOURS=1<<0, HISTORY=1<<1 };
+
+  // One period for which a channel was flagged
+  struct FlaggedChannel{
+    int location_;
+    int flag_;
+    int reasons_; // Reason bits from all the windows in the period
+    Long64_t firstEvent_; // Event numbers count from 0 at the start of the job
+    Long64_t lastEvent_;
+    double rate_; // Mean hits per event over the period
+    double referenceRate_; // Mean reference rate over the period
+    int windows_; // Number of windows in the period
+  };
+
+  ChannelRateMonitor();
+  // neighbours lists the dense indices of the neighbours of each channel
+  void Initialize(const std::string &mapName, int channelCount, DenseIndexFunction denseIndex,
+                  LocationFunction locationFromIndex, const std::vector<std::vector<int> > &neighbours,
+                  const RateMonitorSettings &settings);
+  // Add one event's map branch
+  void Fill(const std::vector<int> &locations);
+  // End any flags that are still open. A partial window at the end is too short to judge, so they
+  // end at the last full window
+  void Finish();
+  const std::vector<FlaggedChannel>& GetFlaggedChannels() const;
+  const std::string& GetMapName() const;
+
+  // Write the flags from all these monitors to a FlaggedChannels tree
+  static void Write(TDirectory *directory, const std::vector<const ChannelRateMonitor*> &monitors);
+
+  // Neighbours in the same side (and wall) with adjacent row and/or column or layer
+  static std::vector<std::vector<int> > TrackerNeighbours();
+  static std::vector<std::vector<int> > CaloNeighbours();
+
+private:
+  std::string mapName_;
+  int channelCount_;
+  DenseIndexFunction denseIndex_;
+  LocationFunction locationFromIndex_;
+  std::vector<std::vector<int> > neighbours_;
+  RateMonitorSettings settings_;
+
+  Long64_t eventCount_; // Events seen so far
+  int eventsInWindow_;
+  std::vector<int> windowCounts_; // Hits per channel in the current window
+  std::vector<int> neighbourCounts_; // Scratch space for the median of a channel's neighbours
+  std::vector<int> history_; // Ring buffer of historyWindows_ windows, one block of channelCount_ per window. -1 if flagged
+  std::vector<Long64_t> historyTotals_; // Hits per channel over the unflagged windows in the ring buffer
+  std::vector<int> historyWindowCounts_; // Number of unflagged windows in the ring buffer for each channel
+  int historySlot_; // Next window in the ring buffer to overwrite
+  int historyFilled_; // Number of windows in the ring buffer so far
+
+  std::vector<int> state_; // Current flag of each channel
+  std::vector<int> openFlag_; // Index in flagged_ of each channel's open flag, or -1
+  std::vector<FlaggedChannel> flagged_;
+
+  void CheckWindow();
+  int JudgeRate(int count, double referenceRate) const;
+  double GetNeighbourMedian(const std::vector<int> &neighbours);
+};
+
+#endif // CHANNELRATEMONITOR_HH
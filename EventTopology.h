@@ -0,0 +1,57 @@
+//! \file    EventTopology.h
+//! \brief   Bitmask classification of events by their reconstructed particles
+//! \details Header only, with no Falaise dependencies, so that analysis macros can use it too
+#ifndef EVENTTOPOLOGY_HH
+#define EVENTTOPOLOGY_HH
+
+// The event_topology branch has exactly one of the topology bits set for an event with at least
+// one particle, and none for an empty event. The flags above them can be set as well.
+// Electrons include positrons. For example, to select two-electron events:
+//   Validation->Draw("h_total_calorimeter_energy","(event_topology & 2)!=0")
+// or, without reading the tree, with the topology_2e entry list written alongside it
+
+const unsigned int TOPOLOGY_1E=1u<<0; // One electron and nothing else
+const unsigned int TOPOLOGY_2E=1u<<1; // Two electrons and nothing else
+const unsigned int TOPOLOGY_1E1G=1u<<2; // One electron and one gamma
+const unsigned int TOPOLOGY_1ENG=1u<<3; // One electron and two or more gammas
+const unsigned int TOPOLOGY_1E1A=1u<<4; // One electron and one alpha, and no gammas
+const unsigned int TOPOLOGY_2ENG=1u<<5; // Two electrons and one or more gammas
+const unsigned int TOPOLOGY_NG=1u<<6; // Only gammas
+const unsigned int TOPOLOGY_3E=1u<<7; // Three or more electrons, with anything else
+const unsigned int TOPOLOGY_OTHER=1u<<8; // Any other combination of particles
+const int TOPOLOGY_COUNT=9;
+
+// Flags, not topologies
+const unsigned int TOPOLOGY_POSITRON=1u<<16; // At least one of the electrons has positron charge
+const unsigned int TOPOLOGY_UNKNOWN=1u<<17; // A particle that couldn't be identified, which isn't counted
+
+// Names of the topology bits, in bit order: the entry lists are topology_<name>
+const char* const TOPOLOGY_NAMES[TOPOLOGY_COUNT]={"1e","2e","1e1g","1eNg","1e1a","2eNg","Ng","3e","other"};
+
+// The topology bit for these particle counts, or 0 if there are no particles
+constexpr unsigned int EventTopology(int electrons, int gammas, int alphas)
+{
+  return (electrons+gammas+alphas==0 ? 0u
+          : electrons>=3 ? TOPOLOGY_3E
+          : electrons==0 ? (alphas==0 ? TOPOLOGY_NG : TOPOLOGY_OTHER)
+          : alphas>0 ? (electrons==1 && alphas==1 && gammas==0 ? TOPOLOGY_1E1A : TOPOLOGY_OTHER)
+          : electrons==1 ? (gammas==0 ? TOPOLOGY_1E : gammas==1 ? TOPOLOGY_1E1G : TOPOLOGY_1ENG)
+          : (gammas==0 ? TOPOLOGY_2E : TOPOLOGY_2ENG));
+}
+
+// Index of a topology bit in TOPOLOGY_NAMES, or -1 if none of them is set
+constexpr int TopologyIndex(unsigned int topology, int index=0)
+{
+  return (index>=TOPOLOGY_COUNT ? -1 : (topology & (1u<<index)) ? index : TopologyIndex(topology,index+1));
+}
+
+static_assert(EventTopology(2,0,0)==TOPOLOGY_2E, "Two electrons");
+static_assert(EventTopology(1,1,0)==TOPOLOGY_1E1G, "One electron, one gamma");
+static_assert(EventTopology(1,3,0)==TOPOLOGY_1ENG, "One electron, several gammas");
+static_assert(EventTopology(1,0,1)==TOPOLOGY_1E1A, "One electron, one alpha");
+static_assert(EventTopology(1,1,1)==TOPOLOGY_OTHER, "An alpha with a gamma isn't 1e1a");
+static_assert(EventTopology(0,2,0)==TOPOLOGY_NG, "Only gammas");
+static_assert(EventTopology(0,0,0)==0, "No particles");
+static_assert(TopologyIndex(TOPOLOGY_OTHER | TOPOLOGY_POSITRON)==TOPOLOGY_COUNT-1, "Flags aren't topologies");
+
+#endif // EVENTTOPOLOGY_HH
@@ -0,0 +1,60 @@
+// ExitAfterEventsModule: ends the process abruptly after a number of events, as if the job had
+// been killed, without resetting any module. For the resume tests: put it after the
+// ValidationModule in an flreconstruct pipeline, and the output is left as it was at its last
+// checkpoint. Not for anything else
+#include "bayeux/datatools/properties.h"
+#include "bayeux/datatools/service_manager.h"
+#include "bayeux/dpp/base_module.h"
+
+#include <cstdlib>
+#include <iostream>
+
+class ExitAfterEventsModule : public dpp::base_module {
+ public:
+  ExitAfterEventsModule() : dpp::base_module(), exitAfterEvents_(0), eventCount_(0) {}
+  virtual ~ExitAfterEventsModule()
+  {
+    if (is_initialized()) this->reset();
+  }
+
+  virtual void initialize(const datatools::properties& myConfig,
+                          datatools::service_manager& /*flServices*/,
+                          dpp::module_handle_dict_type& /*moduleDict*/)
+  {
+    try {
+      myConfig.fetch("exit_after_events",this->exitAfterEvents_);
+    } catch (std::logic_error& e) {
+    }
+    DT_THROW_IF(exitAfterEvents_<0,
+                std::logic_error,
+                "exit_after_events can't be negative");
+    eventCount_=0;
+    this->_set_initialized(true);
+  }
+
+  virtual dpp::base_module::process_status process(datatools::things& /*workItem*/)
+  {
+    // 0 never exits
+    if (++eventCount_==exitAfterEvents_)
+    {
+      std::clog << "Exiting after " << eventCount_ << " events without writing the output" << std::endl;
+      std::_Exit(EXIT_SUCCESS);
+    }
+    return dpp::base_module::PROCESS_OK;
+  }
+
+  virtual void reset()
+  {
+    exitAfterEvents_=0;
+    eventCount_=0;
+    this->_set_initialized(false);
+  }
+
+ private:
+  int exitAfterEvents_;
+  int eventCount_;
+
+  DPP_MODULE_REGISTRATION_INTERFACE(ExitAfterEventsModule);
+};
+
+DPP_MODULE_REGISTRATION_IMPLEMENT(ExitAfterEventsModule,"ExitAfterEventsModule");
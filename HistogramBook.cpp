@@ -0,0 +1,174 @@
+#include "HistogramBook.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+  const int DEFAULT_BINS=100; // For quantities that don't say
+
+  std::string Trim(const std::string &text)
+  {
+    size_t first=text.find_first_not_of(" \t\r");
+    if (first==std::string::npos) return "";
+    size_t last=text.find_last_not_of(" \t\r");
+    return text.substr(first,last-first+1);
+  }
+}
+
+HistogramBook::HistogramBook()
+{}
+
+HistogramBook::~HistogramBook()
+{
+  Clear();
+}
+
+void HistogramBook::Clear()
+{
+  for (size_t i=0;i<histograms_.size();++i) delete histograms_[i];
+  histograms_.clear();
+}
+
+size_t HistogramBook::GetMemoryBytes() const
+{
+  size_t bytes=0;
+  for (size_t i=0;i<histograms_.size();++i)
+  {
+    bytes+=2*(histograms_[i]->GetNbinsX()+2)*sizeof(double);
+    bytes+=2*histograms_[i]->GetBufferSize()*sizeof(double); // A weight and a value for each buffered entry
+  }
+  return bytes;
+}
+
+std::map<std::string,HistogramBinning> HistogramBook::ReadBinning(const std::string &configFile)
+{
+  std::map<std::string,HistogramBinning> binning;
+  std::ifstream input(configFile.c_str());
+  if (!input)
+  {
+    std::cerr << "Could not read histogram config " << configFile << ": all histograms will be auto-ranged" << std::endl;
+    return binning;
+  }
+  std::string line;
+  while (std::getline(input,line))
+  {
+    if (Trim(line).empty() || Trim(line)[0]=='#') continue;
+    std::vector<std::string> fields;
+    std::stringstream lineStream(line);
+    std::string field;
+    while (std::getline(lineStream,field,',')) fields.push_back(Trim(field));
+    if (fields.empty() || fields[0].empty()) continue;
+    HistogramBinning &thisBinning=binning[fields[0]];
+    if (fields.size()>1) thisBinning.title_=fields[1];
+    if (fields.size()>2 && !fields[2].empty()) thisBinning.bins_=std::atoi(fields[2].c_str());
+    if (fields.size()>4 && !fields[3].empty() && !fields[4].empty())
+    {
+      thisBinning.min_=std::atof(fields[3].c_str());
+      thisBinning.max_=std::atof(fields[4].c_str());
+      thisBinning.hasRange_=(thisBinning.max_>thisBinning.min_);
+    }
+  }
+  return binning;
+}
+
+std::string HistogramBook::DefaultTitle(const std::string &name)
+{
+  std::string title=name.substr(name.find('_')+1);
+  for (size_t i=0;i<title.size();++i)
+  {
+    if (title[i]=='_') title[i]=' ';
+  }
+  if (!title.empty()) title[0]=std::toupper(title[0]);
+  return title;
+}
+
+void HistogramBook::Initialize(const std::string &configFile, int warmupEvents)
+{
+  Clear();
+  std::map<std::string,HistogramBinning> binning;
+  if (!configFile.empty()) binning=ReadBinning(configFile);
+  const std::vector<ScalarQuantity> &quantities=GetScalarQuantities();
+  for (size_t quantity=0;quantity<quantities.size();++quantity)
+  {
+    std::string name=quantities[quantity].name_;
+    HistogramBinning thisBinning;
+    std::map<std::string,HistogramBinning>::const_iterator found=binning.find(name);
+    if (found!=binning.end()) thisBinning=found->second;
+    std::string title=(thisBinning.title_.empty() ? DefaultTitle(name) : thisBinning.title_);
+    int bins=(thisBinning.bins_>0 ? thisBinning.bins_ : DEFAULT_BINS);
+    TH1D *histogram;
+    if (thisBinning.hasRange_)
+    {
+      histogram = new TH1D(name.c_str(),title.c_str(),bins,thisBinning.min_,thisBinning.max_);
+    }
+    else
+    {
+      // A range with max <= min makes ROOT choose the range when the buffer is emptied
+      histogram = new TH1D(name.c_str(),title.c_str(),bins,0,0);
+      histogram->SetBuffer(warmupEvents);
+    }
+    histogram->SetDirectory(nullptr); // We write them ourselves
+    histograms_.push_back(histogram);
+  }
+}
+
+void HistogramBook::Fill(const ValidationEventStorage &event)
+{
+  const std::vector<ScalarQuantity> &quantities=GetScalarQuantities();
+  for (size_t quantity=0;quantity<histograms_.size();++quantity)
+  {
+    histograms_[quantity]->Fill(quantities[quantity].GetValue(event));
+  }
+}
+
+void HistogramBook::Write(TDirectory *directory)
+{
+  TDirectory *histogramDirectory=directory->GetDirectory("Histograms");
+  if (!histogramDirectory) histogramDirectory=directory->mkdir("Histograms");
+  for (size_t i=0;i<histograms_.size();++i)
+  {
+    histograms_[i]->BufferEmpty(1); // Fix the range of any that are still warming up
+    histogramDirectory->WriteTObject(histograms_[i],nullptr,"Overwrite");
+  }
+  directory->cd();
+}
+
+// Writes clones, so the histograms being filled are left as they are
+void HistogramBook::WriteCheckpoint(TDirectory *directory) const
+{
+  TDirectory *histogramDirectory=directory->GetDirectory("Histograms");
+  if (!histogramDirectory) histogramDirectory=directory->mkdir("Histograms");
+  for (size_t i=0;i<histograms_.size();++i)
+  {
+    TH1D *clone=(TH1D*)histograms_[i]->Clone();
+    clone->SetDirectory(nullptr);
+    histogramDirectory->WriteTObject(clone,nullptr,"Overwrite");
+    delete clone;
+  }
+  directory->cd();
+}
+
+bool HistogramBook::Read(TDirectory *directory)
+{
+  TDirectory *histogramDirectory=directory->GetDirectory("Histograms");
+  bool found=true;
+  for (size_t i=0;i<histograms_.size();++i)
+  {
+    TH1D *written=nullptr;
+    if (histogramDirectory) histogramDirectory->GetObject(histograms_[i]->GetName(),written);
+    if (!written)
+    {
+      std::cerr << "No histogram " << histograms_[i]->GetName() << " to carry on from" << std::endl;
+      found=false;
+      continue;
+    }
+    written->SetDirectory(nullptr);
+    delete histograms_[i];
+    histograms_[i]=written;
+  }
+  directory->cd();
+  return found;
+}
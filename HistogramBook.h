@@ -0,0 +1,54 @@
+#ifndef HISTOGRAMBOOK_HH
+#define HISTOGRAMBOOK_HH
+#include "TDirectory.h"
+#include "TH1D.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ValidationEventStorage.h"
+
+// Binning for one branch, from a line of the parser config file:
+//   name, title, number of bins, minimum, maximum
+// Any field after the name can be left blank (or missing)
+struct HistogramBinning{
+  std::string title_;
+  int bins_=0;
+  double min_=0;
+  double max_=0;
+  bool hasRange_=false; // Were both the minimum and the maximum given?
+};
+
+// A histogram of each h_ quantity, filled directly from the event storage, so that the standard
+// plots don't need the tree. The binning comes from a file in the ValidateReconstruction.conf format.
+// Quantities without a range in the file buffer their first events and then choose a range from them
+class HistogramBook{
+public:
+  HistogramBook();
+  ~HistogramBook();
+  // configFile can be empty, in which case every histogram is auto-ranged
+  void Initialize(const std::string &configFile, int warmupEvents);
+  void Fill(const ValidationEventStorage &event);
+  // Write the histograms to a Histograms directory, replacing any that are there already
+  void Write(TDirectory *directory);
+  // The same, but as they are so far: the histograms still warming up keep their buffers, so
+  // they choose their range from the same events whether or not the job is checkpointed
+  void WriteCheckpoint(TDirectory *directory) const;
+  // Carry on from the histograms in a directory written by Write, instead of starting empty.
+  // Returns false if any are missing
+  bool Read(TDirectory *directory);
+  void Clear();
+  // Bin contents and errors, and the warm-up buffers
+  size_t GetMemoryBytes() const;
+
+  // Read a config file, returning the binning for each branch name in it
+  static std::map<std::string,HistogramBinning> ReadBinning(const std::string &configFile);
+  // Default title: the name without its prefix, with spaces for underscores and a capital letter
+  static std::string DefaultTitle(const std::string &name);
+
+private:
+  std::vector<TH1D*> histograms_; // One per h_ quantity, in the order of GetScalarQuantities()
+};
+
+#endif // HISTOGRAMBOOK_HH
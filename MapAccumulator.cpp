@@ -0,0 +1,167 @@
+#include "MapAccumulator.h"
+
+#include <iostream>
+
+MapAccumulator::MapAccumulator() : channelCount_(0), denseIndex_(nullptr), locationFromIndex_(nullptr), invalidCount_(0)
+{}
+
+void MapAccumulator::Initialize(const std::string &mapName, const std::vector<std::string> &valueNames, int channelCount,
+                                DenseIndexFunction denseIndex, LocationFunction locationFromIndex)
+{
+  mapName_=mapName;
+  valueNames_=valueNames;
+  channelCount_=channelCount;
+  denseIndex_=denseIndex;
+  locationFromIndex_=locationFromIndex;
+  Clear();
+}
+
+void MapAccumulator::Clear()
+{
+  counts_.assign(channelCount_,0);
+  valueCounts_.assign(channelCount_ * valueNames_.size(),0);
+  sums_.assign(channelCount_ * valueNames_.size(),0);
+  sumSquares_.assign(channelCount_ * valueNames_.size(),0);
+  invalidCount_=0;
+}
+
+void MapAccumulator::Fill(const std::vector<int> &locations, const std::vector<const std::vector<double>*> &values)
+{
+  const size_t valueCount=valueNames_.size();
+  for (size_t hit=0;hit<locations.size();++hit)
+  {
+    int index=denseIndex_(locations[hit]);
+    if (index<0)
+    {
+      ++invalidCount_;
+      continue;
+    }
+    ++counts_[index];
+    for (size_t value=0;value<valueCount && value<values.size();++value)
+    {
+      if (hit>=values[value]->size()) continue; // Shouldn't happen if the branches are paired properly
+      double x=(*values[value])[hit];
+      size_t slot=index*valueCount + value;
+      ++valueCounts_[slot];
+      sums_[slot]+=x;
+      sumSquares_[slot]+=x*x;
+    }
+  }
+}
+
+void MapAccumulator::Merge(const MapAccumulator &other)
+{
+  if (other.mapName_!=mapName_ || other.channelCount_!=channelCount_ || other.valueNames_!=valueNames_)
+  {
+    std::cerr << "Can't merge map " << other.mapName_ << " into " << mapName_ << std::endl;
+    return;
+  }
+  for (size_t i=0;i<counts_.size();++i) counts_[i]+=other.counts_[i];
+  for (size_t i=0;i<sums_.size();++i)
+  {
+    valueCounts_[i]+=other.valueCounts_[i];
+    sums_[i]+=other.sums_[i];
+    sumSquares_[i]+=other.sumSquares_[i];
+  }
+  invalidCount_+=other.invalidCount_;
+}
+
+// Branches are location and count, then <value>_n, <value>_sum and <value>_sum2 for each value,
+// so the mean and spread of each value can be calculated, and files can be merged by adding entries
+void MapAccumulator::Write(TDirectory *directory) const
+{
+  directory->cd();
+  TTree *tree = new TTree(mapName_.c_str(),mapName_.c_str());
+  tree->SetDirectory(directory);
+  int location;
+  Long64_t count;
+  const size_t valueCount=valueNames_.size();
+  std::vector<Long64_t> valueCounts(valueCount);
+  std::vector<double> sums(valueCount);
+  std::vector<double> sumSquares(valueCount);
+  tree->Branch("location",&location);
+  tree->Branch("count",&count);
+  for (size_t value=0;value<valueCount;++value)
+  {
+    tree->Branch((valueNames_.at(value)+"_n").c_str(),&valueCounts.at(value));
+    tree->Branch((valueNames_.at(value)+"_sum").c_str(),&sums.at(value));
+    tree->Branch((valueNames_.at(value)+"_sum2").c_str(),&sumSquares.at(value));
+  }
+  for (int index=0;index<channelCount_;++index)
+  {
+    if (counts_[index]==0) continue;
+    location=locationFromIndex_(index);
+    count=counts_[index];
+    for (size_t value=0;value<valueCount;++value)
+    {
+      size_t slot=index*valueCount + value;
+      valueCounts[value]=valueCounts_[slot];
+      sums[value]=sums_[slot];
+      sumSquares[value]=sumSquares_[slot];
+    }
+    tree->Fill();
+  }
+  tree->Write("",TObject::kOverwrite);
+  delete tree;
+}
+
+bool MapAccumulator::Read(TDirectory *directory)
+{
+  TTree *tree=nullptr;
+  if (directory) directory->GetObject(mapName_.c_str(),tree);
+  if (!tree) return false;
+  int location;
+  Long64_t count;
+  const size_t valueCount=valueNames_.size();
+  std::vector<Long64_t> valueCounts(valueCount);
+  std::vector<double> sums(valueCount);
+  std::vector<double> sumSquares(valueCount);
+  tree->SetBranchAddress("location",&location);
+  tree->SetBranchAddress("count",&count);
+  for (size_t value=0;value<valueCount;++value)
+  {
+    tree->SetBranchAddress((valueNames_.at(value)+"_n").c_str(),&valueCounts.at(value));
+    tree->SetBranchAddress((valueNames_.at(value)+"_sum").c_str(),&sums.at(value));
+    tree->SetBranchAddress((valueNames_.at(value)+"_sum2").c_str(),&sumSquares.at(value));
+  }
+  for (Long64_t entry=0;entry<tree->GetEntries();++entry)
+  {
+    tree->GetEntry(entry);
+    int index=denseIndex_(location);
+    if (index<0 || index>=channelCount_)
+    {
+      invalidCount_+=count;
+      continue;
+    }
+    counts_[index]+=count;
+    for (size_t value=0;value<valueCount;++value)
+    {
+      size_t slot=index*valueCount + value;
+      valueCounts_[slot]+=valueCounts[value];
+      sums_[slot]+=sums[value];
+      sumSquares_[slot]+=sumSquares[value];
+    }
+  }
+  delete tree;
+  return true;
+}
+
+size_t MapAccumulator::GetMemoryBytes() const
+{
+  return (counts_.capacity()+valueCounts_.capacity()+sumSquares_.capacity()+sums_.capacity())*sizeof(Long64_t);
+}
+
+const std::string& MapAccumulator::GetMapName() const
+{
+  return mapName_;
+}
+
+Long64_t MapAccumulator::GetCount(int denseIndex) const
+{
+  return counts_.at(denseIndex);
+}
+
+Long64_t MapAccumulator::GetInvalidCount() const
+{
+  return invalidCount_;
+}
@@ -0,0 +1,56 @@
+#ifndef MAPACCUMULATOR_HH
+#define MAPACCUMULATOR_HH
+#include "TDirectory.h"
+#include "TTree.h"
+
+#include <string>
+#include <vector>
+
+// Running totals for one detector map (tracker cells or calorimeter blocks) over a whole job:
+// the number of hits in each channel, and the count, sum and sum of squares of each value that is
+// averaged over the map. The totals are in flat arrays indexed by the dense index of the location
+// (see CaloLocation.h and TrackerLocation.h), so adding an event's hits is just array updates.
+// The map and value names follow the t_/tm_ and c_/cm_ branch conventions in the README
+class MapAccumulator{
+public:
+  typedef int (*DenseIndexFunction)(int location);
+  typedef int (*LocationFunction)(int denseIndex);
+
+  MapAccumulator();
+  // mapName is the name of the map branch (e.g. t_cell_hit_count), valueNames the names of the
+  // value branches paired with it, without the . suffix (e.g. tm_average_drift_radius)
+  void Initialize(const std::string &mapName, const std::vector<std::string> &valueNames, int channelCount,
+                  DenseIndexFunction denseIndex, LocationFunction locationFromIndex);
+  // Add one event's map branch and the value branches that pair with it, in the same order
+  // as valueNames. Each value vector must have the same number of entries as the locations
+  void Fill(const std::vector<int> &locations, const std::vector<const std::vector<double>*> &values);
+  // Add the totals from another accumulator for the same map
+  void Merge(const MapAccumulator &other);
+  // Set all the totals back to zero
+  void Clear();
+  // Write a tree named after the map, with one entry per channel that was hit. It replaces any
+  // tree of the same name already in the directory
+  void Write(TDirectory *directory) const;
+  // Add the totals from a tree written by Write. Returns false if there isn't one
+  bool Read(TDirectory *directory);
+
+  const std::string& GetMapName() const;
+  Long64_t GetCount(int denseIndex) const;
+  Long64_t GetInvalidCount() const;
+  size_t GetMemoryBytes() const;
+
+private:
+  std::string mapName_;
+  std::vector<std::string> valueNames_;
+  int channelCount_;
+  DenseIndexFunction denseIndex_;
+  LocationFunction locationFromIndex_;
+  std::vector<Long64_t> counts_;
+  // One entry per channel per value: channel i, value v is at i * valueNames_.size() + v
+  std::vector<Long64_t> valueCounts_;
+  std::vector<double> sums_;
+  std::vector<double> sumSquares_;
+  Long64_t invalidCount_; // Locations that weren't in the map
+};
+
+#endif // MAPACCUMULATOR_HH
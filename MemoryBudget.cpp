@@ -0,0 +1,31 @@
+#include "MemoryBudget.h"
+#include "TBranch.h"
+#include "TObjArray.h"
+
+Long64_t MemoryUsage::GetTotal() const
+{
+  return baskets_+events_+accumulators_;
+}
+
+Long64_t GetTreeBasketBytes(TTree *tree)
+{
+  Long64_t bytes=0;
+  TObjArray *branches=tree->GetListOfBranches();
+  if (!branches) return 0;
+  // None of the Validation branches are split, so there are no sub-branches to count
+  for (int i=0;i<branches->GetEntries();++i)
+  {
+    TBranch *branch=dynamic_cast<TBranch*>(branches->At(i));
+    if (branch) bytes+=branch->GetBasketSize();
+  }
+  return bytes;
+}
+
+bool LimitTreeBaskets(TTree *tree, Long64_t maxBytes)
+{
+  if (maxBytes<=0 || GetTreeBasketBytes(tree)<=maxBytes) return false;
+  // Write out what is in the baskets, then share maxBytes between the branches by how much they hold
+  tree->FlushBaskets();
+  tree->OptimizeBaskets(maxBytes,1.1,"");
+  return true;
+}
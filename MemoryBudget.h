@@ -0,0 +1,19 @@
+#ifndef MEMORYBUDGET_HH
+#define MEMORYBUDGET_HH
+#include "TTree.h"
+
+// What the module holds in memory, by where it goes. These are estimates from the sizes of
+// the buffers, not measurements: ROOT and the allocator have their own overheads
+struct MemoryUsage{
+  Long64_t baskets_=0; // Basket buffers of the Validation tree
+  Long64_t events_=0; // Event storage: the vectors' capacity, including any buffers waiting to be written
+  Long64_t accumulators_=0; // Maps, sketches and histograms
+  Long64_t GetTotal() const;
+};
+
+// Total size of the basket buffers of a tree's branches
+Long64_t GetTreeBasketBytes(TTree *tree);
+// If the baskets take more than maxBytes, shrink them to fit. Returns true if they had to shrink
+bool LimitTreeBaskets(TTree *tree, Long64_t maxBytes);
+
+#endif // MEMORYBUDGET_HH
@@ -0,0 +1,69 @@
+#include "OrderedParticleTable.h"
+
+#include <algorithm>
+
+OrderedParticleTable::OrderedParticleTable()
+{
+  Clear();
+}
+
+// Empty the table but keep the memory, ready for the next event
+void OrderedParticleTable::Clear()
+{
+  energy_.clear();
+  time_.clear();
+  vertexX_.clear();
+  vertexY_.clear();
+  vertexZ_.clear();
+  caloHitIds_.clear();
+  caloHitIdStrings_.clear();
+  caloHitStart_.assign(1,0);
+  order_.clear();
+}
+
+size_t OrderedParticleTable::GetSize() const
+{
+  return energy_.size();
+}
+
+size_t OrderedParticleTable::AddParticle(double energy, double time, const TVector3 &vertex)
+{
+  energy_.push_back(energy);
+  time_.push_back(time);
+  vertexX_.push_back(vertex.X());
+  vertexY_.push_back(vertex.Y());
+  vertexZ_.push_back(vertex.Z());
+  caloHitStart_.push_back(caloHitStart_.back());
+  order_.push_back(order_.size()); // Until we sort, they are in the order they were added
+  return energy_.size()-1;
+}
+
+// The calo hit IDs (integers or strings) belong to the last particle added
+// Only use one of these per table, as they share caloHitStart_
+void OrderedParticleTable::AddCaloHit(int location)
+{
+  caloHitIds_.push_back(location);
+  caloHitStart_.back()=caloHitIds_.size();
+}
+
+void OrderedParticleTable::AddCaloHit(const std::string &location)
+{
+  caloHitIdStrings_.push_back(location);
+  caloHitStart_.back()=caloHitIdStrings_.size();
+}
+
+void OrderedParticleTable::SortByEnergy(bool highestFirst)
+{
+  order_.resize(energy_.size());
+  for (size_t row=0;row<order_.size();++row) order_[row]=row;
+  const std::vector<double> &energy=energy_;
+  if (highestFirst)
+    std::stable_sort(order_.begin(),order_.end(),[&energy](size_t a, size_t b) { return energy[a] > energy[b]; });
+  else
+    std::stable_sort(order_.begin(),order_.end(),[&energy](size_t a, size_t b) { return energy[a] < energy[b]; });
+}
+
+const std::vector<size_t>& OrderedParticleTable::GetOrder() const
+{
+  return order_;
+}
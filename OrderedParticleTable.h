@@ -0,0 +1,66 @@
+#ifndef ORDEREDPARTICLETABLE_HH
+#define ORDEREDPARTICLETABLE_HH
+#include "TVector3.h"
+
+#include <string>
+#include <vector>
+
+// Per-event table of the particles that get written to per-particle branches (like the electron vertices)
+// Collect every particle's attributes, then work out a single ordering and apply it to all the output
+// columns, so that every per-particle branch is in the same order
+class OrderedParticleTable{
+public:
+  // One entry per particle
+  std::vector<double> energy_;
+  std::vector<double> time_;
+  std::vector<double> vertexX_;
+  std::vector<double> vertexY_;
+  std::vector<double> vertexZ_;
+  // Any number of entries per particle: particle i has entries caloHitStart_[i] to caloHitStart_[i+1]
+  std::vector<int> caloHitIds_;
+  std::vector<std::string> caloHitIdStrings_;
+  std::vector<size_t> caloHitStart_;
+
+  OrderedParticleTable();
+  void Clear();
+  size_t GetSize() const;
+  // Add a particle, returns its row. Add its calo hits straight after this
+  size_t AddParticle(double energy, double time, const TVector3 &vertex);
+  void AddCaloHit(int location);
+  void AddCaloHit(const std::string &location);
+
+  // Work out the order of the particles by energy (stable, so equal energies keep the order they were added)
+  void SortByEnergy(bool highestFirst);
+  const std::vector<size_t>& GetOrder() const;
+
+  // Append a column with one entry per particle to an output vector, in sorted order
+  template <typename T> void AppendOrdered(const std::vector<T> &column, std::vector<T> &output) const;
+  // Append a column with entries grouped by particle (like caloHitIds_), in sorted particle order
+  template <typename T> void AppendOrderedGroups(const std::vector<T> &column, std::vector<T> &output) const;
+
+private:
+  std::vector<size_t> order_; // order_[n] is the row of the particle that goes in position n
+};
+
+template <typename T>
+void OrderedParticleTable::AppendOrdered(const std::vector<T> &column, std::vector<T> &output) const
+{
+  output.reserve(output.size()+order_.size());
+  for (size_t n=0;n<order_.size();++n)
+  {
+    output.push_back(column[order_[n]]);
+  }
+}
+
+template <typename T>
+void OrderedParticleTable::AppendOrderedGroups(const std::vector<T> &column, std::vector<T> &output) const
+{
+  output.reserve(output.size()+column.size());
+  for (size_t n=0;n<order_.size();++n)
+  {
+    size_t row=order_[n];
+    output.insert(output.end(), column.begin()+caloHitStart_[row], column.begin()+caloHitStart_[row+1]);
+  }
+}
+
+#endif // ORDEREDPARTICLETABLE_HH
@@ -0,0 +1,69 @@
+#include "OutputProfile.h"
+
+bool OutputProfile::SetNamed(const std::string &name)
+{
+  OutputProfile profile;
+  profile.name_=name;
+  if (name=="fast-write")
+  {
+    profile.compressionAlgorithm_=ROOT::kLZ4;
+    profile.compressionLevel_=1;
+    profile.scalarBasketSize_=32000;
+    profile.vectorBasketSize_=64000;
+    profile.autoFlush_=-30000000; // 30 MB, as ROOT does
+    profile.autoSave_=0; // Only write the tree header at the end
+  }
+  else if (name=="archive")
+  {
+    profile.compressionAlgorithm_=ROOT::kLZMA;
+    profile.compressionLevel_=8;
+    profile.scalarBasketSize_=128000;
+    profile.vectorBasketSize_=256000;
+    profile.autoFlush_=-100000000;
+    profile.autoSave_=-1000000000;
+  }
+  else if (name=="analysis")
+  {
+    profile.compressionAlgorithm_=ROOT::kZSTD;
+    profile.compressionLevel_=5;
+    profile.scalarBasketSize_=256000;
+    profile.vectorBasketSize_=512000;
+    profile.autoFlush_=-200000000; // Large clusters, so reading needs few seeks
+    profile.autoSave_=-1000000000;
+  }
+  else if (name!="default") return false;
+  *this=profile;
+  return true;
+}
+
+bool OutputProfile::ParseAlgorithm(const std::string &name, int &algorithm)
+{
+  if (name=="zlib") algorithm=ROOT::kZLIB;
+  else if (name=="lzma") algorithm=ROOT::kLZMA;
+  else if (name=="lz4") algorithm=ROOT::kLZ4;
+  else if (name=="zstd") algorithm=ROOT::kZSTD;
+  else return false;
+  return true;
+}
+
+bool OutputProfile::HasCompression() const
+{
+  return (compressionAlgorithm_>=0 || compressionLevel_>=0);
+}
+
+int OutputProfile::GetCompressionSettings() const
+{
+  // ROOT's default is ZLIB at level 1; keep whichever half wasn't set
+  int algorithm=(compressionAlgorithm_>=0 ? compressionAlgorithm_ : (int)ROOT::kZLIB);
+  int level=(compressionLevel_>=0 ? compressionLevel_ : 1);
+  return ROOT::CompressionSettings((ROOT::ECompressionAlgorithm)algorithm,level);
+}
+
+void OutputProfile::Apply(TTree *tree) const
+{
+  // The h_ branches have one number per event, so they fill their baskets much more slowly
+  if (vectorBasketSize_>0) tree->SetBasketSize("*",vectorBasketSize_);
+  if (scalarBasketSize_>0) tree->SetBasketSize("h_*",scalarBasketSize_);
+  if (autoFlush_!=-1) tree->SetAutoFlush(autoFlush_);
+  if (autoSave_!=-1) tree->SetAutoSave(autoSave_);
+}
@@ -0,0 +1,36 @@
+#ifndef OUTPUTPROFILE_HH
+#define OUTPUTPROFILE_HH
+#include "TTree.h"
+#include "Compression.h"
+
+#include <string>
+
+// How the output file is compressed and how its trees are split into baskets and clusters.
+// The named profiles are:
+//   default:    whatever ROOT does
+//   fast-write: LZ4, for when writing is the bottleneck
+//   archive:    LZMA at a high level, for files that are kept but rarely read
+//   analysis:   ZSTD with large baskets and clusters, for files that are read many times
+// Any setting can then be changed individually. A setting of -1 leaves ROOT's default
+struct OutputProfile{
+  std::string name_="default";
+  int compressionAlgorithm_=-1; // ROOT::ECompressionAlgorithm
+  int compressionLevel_=-1;
+  int scalarBasketSize_=-1; // Bytes per basket for the h_ branches
+  int vectorBasketSize_=-1; // And for all the others
+  Long64_t autoFlush_=-1; // As for TTree::SetAutoFlush: positive is entries, negative is bytes; 0 means never
+  Long64_t autoSave_=-1; // As for TTree::SetAutoSave (same signs); 0 means never
+  int implicitMTThreads_=0; // Compress baskets in parallel with ROOT implicit multithreading, if more than 0
+
+  // Set everything from a named profile. Returns false, leaving it unchanged, if there isn't one
+  bool SetNamed(const std::string &name);
+  // Compression algorithm from a name: zlib, lzma, lz4 or zstd. Returns false if it isn't one of these
+  static bool ParseAlgorithm(const std::string &name, int &algorithm);
+  bool HasCompression() const;
+  // For the TFile constructor
+  int GetCompressionSettings() const;
+  // Basket sizes and cadence for a tree whose branches have all been booked
+  void Apply(TTree *tree) const;
+};
+
+#endif // OUTPUTPROFILE_HH
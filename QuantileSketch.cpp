@@ -0,0 +1,184 @@
+#include "QuantileSketch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+QuantileSketch::QuantileSketch(double relativeAccuracy)
+{
+  relativeAccuracy_=relativeAccuracy;
+  gamma_=(1+relativeAccuracy)/(1-relativeAccuracy);
+  logGamma_=std::log(gamma_);
+  minIndexable_=1e-9;
+  Clear();
+}
+
+void QuantileSketch::Clear()
+{
+  positive_=BucketStore();
+  negative_=BucketStore();
+  zeroCount_=0;
+  count_=0;
+  min_=std::numeric_limits<double>::max();
+  max_=std::numeric_limits<double>::lowest();
+  sum_=0;
+}
+
+void QuantileSketch::BucketStore::Add(int index, Long64_t count)
+{
+  if (counts_.empty())
+  {
+    offset_=index;
+    counts_.push_back(0);
+  }
+  else if (index<offset_)
+  {
+    counts_.insert(counts_.begin(),offset_-index,0);
+    offset_=index;
+  }
+  else if (index>=offset_+(int)counts_.size())
+  {
+    counts_.resize(index-offset_+1,0);
+  }
+  counts_[index-offset_]+=count;
+  total_+=count;
+}
+
+int QuantileSketch::GetIndex(double absValue) const
+{
+  return (int)std::ceil(std::log(absValue)/logGamma_);
+}
+
+double QuantileSketch::GetValue(int index) const
+{
+  // The middle of the bucket (gamma^(i-1), gamma^i], in the sense that minimizes the relative error
+  return 2*std::pow(gamma_,index)/(gamma_+1);
+}
+
+void QuantileSketch::Add(double value)
+{
+  if (value>minIndexable_) positive_.Add(GetIndex(value),1);
+  else if (value< -minIndexable_) negative_.Add(GetIndex(-value),1);
+  else ++zeroCount_;
+  ++count_;
+  min_=std::min(min_,value);
+  max_=std::max(max_,value);
+  sum_+=value;
+}
+
+bool QuantileSketch::Merge(const QuantileSketch &other)
+{
+  if (other.relativeAccuracy_!=relativeAccuracy_)
+  {
+    std::cerr << "Can't merge quantile sketches with relative accuracy " << other.relativeAccuracy_ << " and " << relativeAccuracy_ << std::endl;
+    return false;
+  }
+  std::vector<int> indices;
+  std::vector<Long64_t> counts;
+  other.GetBuckets(false,indices,counts);
+  AddBuckets(false,indices,counts);
+  other.GetBuckets(true,indices,counts);
+  AddBuckets(true,indices,counts);
+  AddSummary(other.zeroCount_,other.min_,other.max_,other.sum_);
+  return true;
+}
+
+// Rank the values from the most negative (largest negative bucket) up to the largest positive bucket
+double QuantileSketch::GetQuantile(double q) const
+{
+  if (count_==0) return 0;
+  if (q<=0) return min_;
+  if (q>=1) return max_;
+  double rank=q*(count_-1);
+  double value;
+  Long64_t seen=0;
+  for (int i=(int)negative_.counts_.size()-1;i>=0;--i)
+  {
+    seen+=negative_.counts_[i];
+    if (seen>rank)
+    {
+      value=-GetValue(i+negative_.offset_);
+      return std::max(min_,std::min(max_,value));
+    }
+  }
+  seen+=zeroCount_;
+  if (seen>rank) return 0;
+  for (size_t i=0;i<positive_.counts_.size();++i)
+  {
+    seen+=positive_.counts_[i];
+    if (seen>rank)
+    {
+      value=GetValue(i+positive_.offset_);
+      return std::max(min_,std::min(max_,value));
+    }
+  }
+  return max_;
+}
+
+Long64_t QuantileSketch::GetCount() const
+{
+  return count_;
+}
+
+double QuantileSketch::GetMin() const
+{
+  return min_;
+}
+
+double QuantileSketch::GetMax() const
+{
+  return max_;
+}
+
+double QuantileSketch::GetSum() const
+{
+  return sum_;
+}
+
+double QuantileSketch::GetRelativeAccuracy() const
+{
+  return relativeAccuracy_;
+}
+
+Long64_t QuantileSketch::GetZeroCount() const
+{
+  return zeroCount_;
+}
+
+void QuantileSketch::GetBuckets(bool negative, std::vector<int> &indices, std::vector<Long64_t> &counts) const
+{
+  const BucketStore &store=(negative ? negative_ : positive_);
+  indices.clear();
+  counts.clear();
+  for (size_t i=0;i<store.counts_.size();++i)
+  {
+    if (store.counts_[i]==0) continue;
+    indices.push_back(i+store.offset_);
+    counts.push_back(store.counts_[i]);
+  }
+}
+
+size_t QuantileSketch::GetMemoryBytes() const
+{
+  return sizeof(QuantileSketch)+(positive_.counts_.capacity()+negative_.counts_.capacity())*sizeof(Long64_t);
+}
+
+void QuantileSketch::AddBuckets(bool negative, const std::vector<int> &indices, const std::vector<Long64_t> &counts)
+{
+  BucketStore &store=(negative ? negative_ : positive_);
+  for (size_t i=0;i<indices.size() && i<counts.size();++i)
+  {
+    store.Add(indices[i],counts[i]);
+    count_+=counts[i];
+  }
+}
+
+void QuantileSketch::AddSummary(Long64_t zeroCount, double min, double max, double sum)
+{
+  zeroCount_+=zeroCount;
+  count_+=zeroCount;
+  min_=std::min(min_,min);
+  max_=std::max(max_,max);
+  sum_+=sum;
+}
@@ -0,0 +1,64 @@
+#ifndef QUANTILESKETCH_HH
+#define QUANTILESKETCH_HH
+#include "Rtypes.h"
+
+#include <cstddef>
+#include <vector>
+
+// Streaming quantile sketch for one quantity, with logarithmic buckets (the DDSketch method):
+// a value x > 0 goes in bucket ceil(log(x)/log(gamma)), where gamma = (1+a)/(1-a), so any
+// quantile is returned to within a relative accuracy a. Negative values have their own buckets,
+// and values too close to zero are just counted.
+// The buckets are never collapsed, so merging two sketches (adding their bucket counts) gives
+// exactly the sketch of all the values from both, in any order. Values are assumed not to span
+// a huge range: the number of buckets is about log(max/min)/a
+class QuantileSketch{
+public:
+  explicit QuantileSketch(double relativeAccuracy=0.01);
+
+  void Add(double value);
+  // Add the contents of a sketch with the same relative accuracy. Returns false if they don't match
+  bool Merge(const QuantileSketch &other);
+  void Clear();
+
+  // Value at quantile q (0 to 1), or 0 if the sketch is empty
+  double GetQuantile(double q) const;
+  Long64_t GetCount() const;
+  double GetMin() const;
+  double GetMax() const;
+  double GetSum() const;
+  double GetRelativeAccuracy() const;
+  size_t GetMemoryBytes() const;
+
+  // The non-empty buckets, for writing out, and for reading them back
+  Long64_t GetZeroCount() const;
+  void GetBuckets(bool negative, std::vector<int> &indices, std::vector<Long64_t> &counts) const;
+  void AddBuckets(bool negative, const std::vector<int> &indices, const std::vector<Long64_t> &counts);
+  void AddSummary(Long64_t zeroCount, double min, double max, double sum); // Use with AddBuckets
+
+private:
+  // Counts for a contiguous range of bucket indices, which grows as needed
+  struct BucketStore{
+    std::vector<Long64_t> counts_;
+    int offset_=0; // Bucket index of counts_[0]
+    Long64_t total_=0;
+    void Add(int index, Long64_t count);
+  };
+
+  int GetIndex(double absValue) const;
+  double GetValue(int index) const; // Representative value of a bucket
+
+  double relativeAccuracy_;
+  double gamma_;
+  double logGamma_;
+  double minIndexable_; // Values with a smaller size than this count as zero
+  BucketStore positive_;
+  BucketStore negative_; // Indexed by the absolute value
+  Long64_t zeroCount_;
+  Long64_t count_;
+  double min_;
+  double max_;
+  double sum_;
+};
+
+#endif // QUANTILESKETCH_HH
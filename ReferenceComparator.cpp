@@ -0,0 +1,211 @@
+#include "ReferenceComparator.h"
+
+#include <iostream>
+
+#include "CaloLocation.h"
+#include "TrackerLocation.h"
+
+ReferenceComparator::ReferenceComparator() : eventCount_(0)
+{}
+
+ReferenceComparator::~ReferenceComparator()
+{
+  Clear();
+}
+
+void ReferenceComparator::Clear()
+{
+  for (size_t i=0;i<comparisons_.size();++i)
+  {
+    delete comparisons_[i].reference_;
+    delete comparisons_[i].current_;
+  }
+  comparisons_.clear();
+  alarms_.clear();
+  eventCount_=0;
+}
+
+size_t ReferenceComparator::Initialize(const std::string &referenceFile, const ReferenceSettings &settings)
+{
+  Clear();
+  settings_=settings;
+  TFile *file=TFile::Open(referenceFile.c_str(),"READ");
+  if (!file || file->IsZombie())
+  {
+    std::cerr << "Could not open reference file " << referenceFile << std::endl;
+    delete file;
+    return 0;
+  }
+  // The h_ quantities
+  const std::vector<ScalarQuantity> &quantities=GetScalarQuantities();
+  for (size_t quantity=0;quantity<quantities.size();++quantity)
+  {
+    std::string name=quantities[quantity].name_;
+    TH1 *reference=nullptr;
+    file->GetObject(("Histograms/"+name).c_str(),reference);
+    if (!reference) file->GetObject(name.c_str(),reference);
+    if (!reference) continue;
+    reference=(TH1*)reference->Clone(("reference_"+name).c_str());
+    reference->SetDirectory(nullptr);
+    AddComparison(reference,name,quantity,nullptr,nullptr);
+  }
+  // The maps
+  TH1 *reference=LoadMapReference(file,"t_cell_hit_count",TRACKER_CELL_COUNT);
+  if (reference) AddComparison(reference,"t_cell_hit_count",0,&ValidationEventStorage::t_cell_hit_count_,TrackerDenseIndex);
+  reference=LoadMapReference(file,"t_track_cell_hit_map",TRACKER_CELL_COUNT);
+  if (reference) AddComparison(reference,"t_track_cell_hit_map",0,&ValidationEventStorage::t_track_cell_hit_map_,TrackerDenseIndex);
+  reference=LoadMapReference(file,"c_calorimeter_hit_map",CALO_BLOCK_COUNT);
+  if (reference) AddComparison(reference,"c_calorimeter_hit_map",0,&ValidationEventStorage::c_calorimeter_hit_map_,CaloDenseIndex);
+  reference=LoadMapReference(file,"c_calorimeter_hit_map_backscatter",CALO_BLOCK_COUNT);
+  if (reference) AddComparison(reference,"c_calorimeter_hit_map_backscatter",0,&ValidationEventStorage::c_calorimeter_hit_map_backscatter_,CaloDenseIndex);
+
+  file->Close();
+  delete file;
+  std::cout << "Comparing " << comparisons_.size() << " distributions with " << referenceFile << std::endl;
+  return comparisons_.size();
+}
+
+// A histogram of the hits in each channel, binned by dense index, from a tree written by MapAccumulator
+TH1* ReferenceComparator::LoadMapReference(TFile *file, const std::string &mapName, int channelCount)
+{
+  TTree *tree=nullptr;
+  file->GetObject(("Maps/"+mapName).c_str(),tree);
+  if (!tree) return nullptr;
+  int location=0;
+  Long64_t count=0;
+  tree->SetBranchAddress("location",&location);
+  tree->SetBranchAddress("count",&count);
+  TH1D *reference = new TH1D(("reference_"+mapName).c_str(),mapName.c_str(),channelCount,0,channelCount);
+  reference->SetDirectory(nullptr);
+  for (Long64_t entry=0;entry<tree->GetEntries();++entry)
+  {
+    tree->GetEntry(entry);
+    int index=(channelCount==TRACKER_CELL_COUNT ? TrackerDenseIndex(location) : CaloDenseIndex(location));
+    if (index>=0) reference->SetBinContent(index+1,count);
+  }
+  reference->SetEntries(reference->Integral());
+  return reference;
+}
+
+void ReferenceComparator::AddComparison(TH1 *reference, const std::string &name, size_t quantity,
+                                        std::vector<int> ValidationEventStorage::* locations, DenseIndexFunction denseIndex)
+{
+  Comparison comparison;
+  comparison.name_=name;
+  comparison.quantity_=quantity;
+  comparison.locations_=locations;
+  comparison.denseIndex_=denseIndex;
+  comparison.reference_=reference;
+  comparison.current_=(TH1*)reference->Clone(("current_"+name).c_str());
+  comparison.current_->SetDirectory(nullptr);
+  comparison.current_->Reset();
+  comparison.chi2Probability_=1;
+  comparison.ksDistance_=0;
+  comparison.alarmed_=false;
+  comparisons_.push_back(comparison);
+}
+
+bool ReferenceComparator::Fill(const ValidationEventStorage &event)
+{
+  if (comparisons_.empty()) return false;
+  const std::vector<ScalarQuantity> &quantities=GetScalarQuantities();
+  for (size_t i=0;i<comparisons_.size();++i)
+  {
+    Comparison &comparison=comparisons_[i];
+    if (!comparison.locations_)
+    {
+      comparison.current_->Fill(quantities[comparison.quantity_].GetValue(event));
+      continue;
+    }
+    const std::vector<int> &locations=event.*comparison.locations_;
+    for (size_t hit=0;hit<locations.size();++hit)
+    {
+      int index=comparison.denseIndex_(locations[hit]);
+      if (index>=0) comparison.current_->Fill(index);
+    }
+  }
+  ++eventCount_;
+  if (eventCount_ % settings_.checkEvents_ != 0) return false;
+  return Compare();
+}
+
+bool ReferenceComparator::Compare()
+{
+  bool newAlarm=false;
+  for (size_t i=0;i<comparisons_.size();++i)
+  {
+    Comparison &comparison=comparisons_[i];
+    if (comparison.current_->GetEntries()==0) continue;
+    // Both are unweighted counts, so "UU"; the normalizations can differ
+    comparison.chi2Probability_=comparison.current_->Chi2Test(comparison.reference_,"UU");
+    comparison.ksDistance_=comparison.current_->KolmogorovTest(comparison.reference_,"M");
+    if (comparison.alarmed_) continue; // Only alarm once for each quantity
+    if (comparison.chi2Probability_ < settings_.minChi2Probability_ || comparison.ksDistance_ > settings_.maxKSDistance_)
+    {
+      comparison.alarmed_=true;
+      newAlarm=true;
+      Alarm alarm;
+      alarm.name_=comparison.name_;
+      alarm.event_=eventCount_;
+      alarm.chi2Probability_=comparison.chi2Probability_;
+      alarm.ksDistance_=comparison.ksDistance_;
+      alarm.entries_=comparison.current_->GetEntries();
+      alarms_.push_back(alarm);
+      std::cout << "Reference alarm after " << eventCount_ << " events: " << comparison.name_
+                << " has chi2 probability " << comparison.chi2Probability_
+                << " and KS distance " << comparison.ksDistance_ << std::endl;
+    }
+  }
+  return newAlarm;
+}
+
+void ReferenceComparator::Write(TDirectory *directory)
+{
+  directory->cd();
+  std::string name;
+  Long64_t event;
+  double chi2Probability;
+  double ksDistance;
+  double entries;
+  bool alarmed;
+
+  TTree *alarmTree = new TTree("ReferenceAlarms","Distributions that diverged from the reference");
+  alarmTree->SetDirectory(directory);
+  alarmTree->Branch("name",&name);
+  alarmTree->Branch("event",&event);
+  alarmTree->Branch("chi2_probability",&chi2Probability);
+  alarmTree->Branch("ks_distance",&ksDistance);
+  alarmTree->Branch("entries",&entries);
+  for (size_t i=0;i<alarms_.size();++i)
+  {
+    name=alarms_[i].name_;
+    event=alarms_[i].event_;
+    chi2Probability=alarms_[i].chi2Probability_;
+    ksDistance=alarms_[i].ksDistance_;
+    entries=alarms_[i].entries_;
+    alarmTree->Fill();
+  }
+  alarmTree->Write();
+  delete alarmTree;
+
+  TTree *comparisonTree = new TTree("ReferenceComparison","Last comparison of each distribution with the reference");
+  comparisonTree->SetDirectory(directory);
+  comparisonTree->Branch("name",&name);
+  comparisonTree->Branch("event",&event);
+  comparisonTree->Branch("chi2_probability",&chi2Probability);
+  comparisonTree->Branch("ks_distance",&ksDistance);
+  comparisonTree->Branch("entries",&entries);
+  comparisonTree->Branch("alarmed",&alarmed);
+  for (size_t i=0;i<comparisons_.size();++i)
+  {
+    name=comparisons_[i].name_;
+    event=eventCount_;
+    chi2Probability=comparisons_[i].chi2Probability_;
+    ksDistance=comparisons_[i].ksDistance_;
+    entries=comparisons_[i].current_->GetEntries();
+    alarmed=comparisons_[i].alarmed_;
+    comparisonTree->Fill();
+  }
+  comparisonTree->Write();
+  delete comparisonTree;
+}
@@ -0,0 +1,76 @@
+#ifndef REFERENCECOMPARATOR_HH
+#define REFERENCECOMPARATOR_HH
+#include "TDirectory.h"
+#include "TFile.h"
+#include "TH1.h"
+#include "TH1D.h"
+#include "TTree.h"
+
+#include <string>
+#include <vector>
+
+#include "ValidationEventStorage.h"
+
+// Settings for the comparison with the reference distributions
+struct ReferenceSettings{
+  int checkEvents_=1000; // Compare every this many events
+  double minChi2Probability_=1e-6; // Alarm if the chi2 test probability is below this
+  double maxKSDistance_=0.1; // or if the Kolmogorov-Smirnov distance is above this
+};
+
+// Compares the distributions of this job with reference distributions while it runs.
+// The reference file is the output of an earlier, good, job: the h_ quantities are compared with
+// the histograms in its Histograms directory (or at the top level), and the maps with the trees in
+// its Maps directory (see accumulate_maps), as histograms of the dense channel index.
+// Every checkEvents_ events, each quantity that has a reference is compared with a chi2 test and
+// the maximum Kolmogorov-Smirnov distance. The first time a quantity is past either threshold it
+// raises an alarm
+class ReferenceComparator{
+public:
+  ReferenceComparator();
+  ~ReferenceComparator();
+  // Load the references. Returns the number of quantities that have one
+  size_t Initialize(const std::string &referenceFile, const ReferenceSettings &settings);
+  // Add one event. Returns true if a quantity raised an alarm at this event
+  bool Fill(const ValidationEventStorage &event);
+  // Compare everything now, whether or not it is time to
+  bool Compare();
+  // Write the alarms to a ReferenceAlarms tree, and the last comparison of every quantity to ReferenceComparison
+  void Write(TDirectory *directory);
+  void Clear();
+
+private:
+  typedef int (*DenseIndexFunction)(int location);
+
+  struct Comparison{
+    std::string name_;
+    size_t quantity_; // For h_ quantities: index in GetScalarQuantities()
+    std::vector<int> ValidationEventStorage::* locations_; // For maps, or null
+    DenseIndexFunction denseIndex_;
+    TH1 *reference_;
+    TH1 *current_; // Same binning as the reference
+    double chi2Probability_; // From the last comparison
+    double ksDistance_;
+    bool alarmed_;
+  };
+
+  // An alarm, for the ReferenceAlarms tree
+  struct Alarm{
+    std::string name_;
+    Long64_t event_; // Number of events so far
+    double chi2Probability_;
+    double ksDistance_;
+    double entries_;
+  };
+
+  ReferenceSettings settings_;
+  Long64_t eventCount_;
+  std::vector<Comparison> comparisons_;
+  std::vector<Alarm> alarms_;
+
+  TH1* LoadMapReference(TFile *file, const std::string &mapName, int channelCount);
+  void AddComparison(TH1 *reference, const std::string &name, size_t quantity,
+                     std::vector<int> ValidationEventStorage::* locations, DenseIndexFunction denseIndex);
+};
+
+#endif // REFERENCECOMPARATOR_HH
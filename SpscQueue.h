@@ -0,0 +1,69 @@
+//! \file    SpscQueue.h
+//! \brief   Bounded lock-free queue for one producer thread and one consumer thread
+#ifndef SPSCQUEUE_HH
+#define SPSCQUEUE_HH
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// A ring buffer with one index written by each side. The producer only writes head_ and
+// the consumer only writes tail_, so no locks are needed: the release/acquire pairs make an
+// item visible to the consumer only after it has been written, and a slot reusable by the
+// producer only after it has been read.
+// The capacity is rounded up to a power of two. Resize before the threads start
+template <typename T>
+class SpscQueue{
+public:
+  SpscQueue() : mask_(0), head_(0), tail_(0) {}
+  explicit SpscQueue(size_t capacity) : SpscQueue() { Resize(capacity); }
+  SpscQueue(const SpscQueue&)=delete;
+  SpscQueue& operator=(const SpscQueue&)=delete;
+
+  // Not thread safe: empties the queue
+  void Resize(size_t capacity)
+  {
+    size_t size=1;
+    while (size<capacity) size*=2;
+    items_.assign(size,T());
+    mask_=size-1;
+    head_.store(0,std::memory_order_relaxed);
+    tail_.store(0,std::memory_order_relaxed);
+  }
+
+  // Producer only. Returns false if the queue is full
+  bool TryPush(const T &item)
+  {
+    const size_t head=head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) > mask_) return false;
+    items_[head & mask_]=item;
+    head_.store(head+1,std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only. Returns false if the queue is empty
+  bool TryPop(T &item)
+  {
+    const size_t tail=tail_.load(std::memory_order_relaxed);
+    if (tail==head_.load(std::memory_order_acquire)) return false;
+    item=items_[tail & mask_];
+    tail_.store(tail+1,std::memory_order_release);
+    return true;
+  }
+
+  bool IsEmpty() const
+  {
+    return head_.load(std::memory_order_acquire)==tail_.load(std::memory_order_acquire);
+  }
+
+  size_t GetCapacity() const { return items_.size(); }
+
+private:
+  std::vector<T> items_;
+  size_t mask_;
+  // On separate cache lines, so the two threads don't keep invalidating each other's
+  alignas(64) std::atomic<size_t> head_;
+  alignas(64) std::atomic<size_t> tail_;
+};
+
+#endif // SPSCQUEUE_HH
@@ -0,0 +1,409 @@
+#include "TrackBatch.h"
+
+using namespace std;
+
+TrackBatch::TrackBatch()
+{}
+
+TrackBatch::TrackBatch(const geomtools::manager* geometry_manager, const snemo::datamodel::particle_track_data& trackData)
+{
+  this->Initialize(geometry_manager, trackData);
+}
+
+void TrackBatch::Initialize(const geomtools::manager* geometry_manager, const snemo::datamodel::particle_track_data& trackData)
+{
+  geometry_manager_=geometry_manager;
+  tracks_.clear();
+  if (trackData.has_particles())
+  {
+    for (size_t iParticle=0;iParticle<trackData.get_number_of_particles();++iParticle)
+    {
+      tracks_.push_back(&trackData.get_particle(iParticle));
+    }
+  }
+  Resize(tracks_.size());
+  for (size_t i=0;i<tracks_.size();++i) Classify(i);
+}
+
+void TrackBatch::Initialize(const geomtools::manager* geometry_manager, const snemo::datamodel::particle_track& track)
+{
+  geometry_manager_=geometry_manager;
+  tracks_.assign(1,&track);
+  Resize(1);
+  Classify(0);
+}
+
+// Set every column to its default, ready to be filled
+void TrackBatch::Resize(size_t size)
+{
+  foilmostVerticesDone_=false;
+  directionsDone_=false;
+  projectedVerticesDone_=false;
+  caloHitsDone_=false;
+
+  particleType_.assign(size,UNKNOWN);
+  charge_.assign(size,1);
+  flags_.assign(size,0);
+  trackerHitCount_.assign(size,0);
+  trackLength_.assign(size,0);
+  trackLengthSigma_.assign(size,0);
+  projectedLength_.assign(size,0);
+  delayTime_.assign(size,0);
+
+  vertexX_.assign(size,TRACK_NO_VALUE);
+  vertexY_.assign(size,TRACK_NO_VALUE);
+  vertexZ_.assign(size,TRACK_NO_VALUE);
+  directionX_.assign(size,TRACK_NO_VALUE);
+  directionY_.assign(size,TRACK_NO_VALUE);
+  directionZ_.assign(size,TRACK_NO_VALUE);
+  projectedX_.assign(size,TRACK_NO_VALUE);
+  projectedY_.assign(size,TRACK_NO_VALUE);
+  projectedZ_.assign(size,TRACK_NO_VALUE);
+
+  energy_.assign(size,0);
+  energySigma_.assign(size,0);
+  time_.assign(size,0);
+  timeSigma_.assign(size,0);
+  mainwallFraction_.assign(size,0);
+  xwallFraction_.assign(size,0);
+  vetoFraction_.assign(size,0);
+  beta_.assign(size,0);
+  firstHitType_.assign(size,-1);
+  firstHitIndex_.assign(size,-1);
+  associatedEnergy_.assign(size,0);
+  associatedEnergyOverThreshold_.assign(size,0);
+  caloHitIds_.clear();
+  caloHitIdStart_.assign(size+1,0);
+}
+
+void TrackBatch::Clear()
+{
+  tracks_.clear();
+  Resize(0);
+}
+
+size_t TrackBatch::GetSize() const
+{
+  return tracks_.size();
+}
+
+const snemo::datamodel::particle_track& TrackBatch::GetTrack(size_t i) const
+{
+  return *tracks_.at(i);
+}
+
+bool TrackBatch::HasFlag(size_t i, Flag flag) const
+{
+  return (flags_[i] & flag);
+}
+
+// Works out the type of particle (gamma, alpha, electron) and the cheap track details
+void TrackBatch::Classify(size_t i)
+{
+  const snemo::datamodel::particle_track & track = *tracks_[i];
+  charge_[i]=(int)track.get_charge();
+  switch (charge_[i])
+  {
+    case snemo::datamodel::particle_track::NEUTRAL:
+    {
+      particleType_[i]=GAMMA;
+      return;
+    } // end case neutral (gammas)
+
+    // Any of these will make a track
+    case snemo::datamodel::particle_track::POSITIVE:
+    case snemo::datamodel::particle_track::NEGATIVE:
+    case snemo::datamodel::particle_track::UNDEFINED: // Used for straight tracks
+    flags_[i] |= MAKES_TRACK;
+    break;
+    default:
+      return; // Nothing we can do here so we are done
+  }//end switch
+
+  if (!track.has_trajectory()) return;
+  flags_[i] |= HAS_TRAJECTORY;
+
+  const snemo::datamodel::tracker_trajectory & the_trajectory = track.get_trajectory();
+  const snemo::datamodel::tracker_cluster & the_cluster = the_trajectory.get_cluster();
+
+  // Number of hits and lengths of track
+  trackerHitCount_[i] = the_cluster.get_number_of_hits(); // Currently a track only contains 1 cluster
+  trackLength_[i] = the_trajectory.get_pattern().get_shape().get_length();
+
+  // ALPHA candidates are undefined charge particles associated with a delayed hit and no associated hit
+  if (track.get_charge()==snemo::datamodel::particle_track::UNDEFINED && !track.has_associated_calorimeter_hits() && the_cluster.is_delayed()>0)
+  {
+    particleType_[i]=ALPHA;
+    delayTime_[i] = (the_cluster.get_hit(0).get_delayed_time());
+  }
+  // ELECTRON candidates are prompt and have an associated calorimeter hit. No charge requirement as yet
+  else if (the_cluster.is_delayed()<=0 && track.has_associated_calorimeter_hits())
+  {
+    particleType_[i]=ELECTRON;
+  }
+  // Otherwise not an alpha or an electron, what could it be?
+}
+
+void TrackBatch::EnsureFoilmostVertices()
+{
+  if (foilmostVerticesDone_) return;
+  foilmostVerticesDone_=true;
+  for (size_t i=0;i<tracks_.size();++i)
+  {
+    if (particleType_[i]==GAMMA) SetGammaVertex(i);
+    else if (HasFlag(i,HAS_TRAJECTORY) && SetFoilmostVertex(i)) flags_[i] |= VERTEX_ON_FOIL;
+  }
+}
+
+void TrackBatch::EnsureDirections()
+{
+  if (directionsDone_) return;
+  directionsDone_=true;
+  for (size_t i=0;i<tracks_.size();++i)
+  {
+    if (HasFlag(i,HAS_TRAJECTORY) && SetDirection(i)) flags_[i] |= HAS_DIRECTION;
+  }
+}
+
+// Populate the projected vertex with where the vertex would be if it were projected back to the foil
+// At the moment this uses a simple linear projection; would be better to project the helix
+// PROJECTS_TO_FOIL is left unset if the vertex does not project back to the foil (track would not intersect foil or we don't have enough info)
+void TrackBatch::EnsureProjectedVertices()
+{
+  if (projectedVerticesDone_) return;
+  projectedVerticesDone_=true;
+  EnsureDirections(); // Can't project if no direction!
+  EnsureFoilmostVertices();
+  for (size_t i=0;i<tracks_.size();++i)
+  {
+    // Check that we have the necessary to do this calculation
+    if (!HasFlag(i,HAS_DIRECTION) || vertexX_[i]==TRACK_NO_VALUE || trackLength_[i]==0) continue;
+    double scale=vertexX_[i]/directionX_[i];
+    // The second term is the extension to the track to project it back with a straight line
+    projectedX_[i]=vertexX_[i] - scale*directionX_[i];
+    projectedY_[i]=vertexY_[i] - scale*directionY_[i];
+    projectedZ_[i]=vertexZ_[i] - scale*directionZ_[i];
+    projectedLength_[i]=trackLength_[i]+TMath::Abs(scale)*TMath::Sqrt(directionX_[i]*directionX_[i] + directionY_[i]*directionY_[i] + directionZ_[i]*directionZ_[i]);
+    // The direction has been chosen so it will always point outwards from the foil.
+    // The calculation should always give a projected X coordinate of 0
+    // But if it projects in such a way that the y or z values are outside the detector, it doesn't reach the foil
+    if (TMath::Abs(projectedY_[i]) <= MAXY && TMath::Abs(projectedZ_[i]) <= MAXZ) flags_[i] |= PROJECTS_TO_FOIL;
+  }
+}
+
+void TrackBatch::EnsureCaloHits()
+{
+  if (caloHitsDone_) return;
+  caloHitsDone_=true;
+  caloHitIds_.clear();
+  caloHitIdStart_.assign(1,0);
+  for (size_t i=0;i<tracks_.size();++i)
+  {
+    // Only electrons and gammas have calo hits we can use to calculate the hit fractions
+    bool usesCaloHits=(particleType_[i]==ELECTRON || particleType_[i]==GAMMA);
+    // One pass over the associated hits gets everything we need from them
+    if (usesCaloHits || tracks_[i]->has_associated_calorimeter_hits())
+    {
+      SummarizeCaloHits(tracks_[i]->get_associated_calorimeter_hits(), caloHitSummary_);
+      associatedEnergy_[i]=caloHitSummary_.energy_;
+      associatedEnergyOverThreshold_[i]=caloHitSummary_.energyOverThreshold_;
+      caloHitIds_.insert(caloHitIds_.end(), caloHitSummary_.encodedIds_.begin(), caloHitSummary_.encodedIds_.end());
+      if (usesCaloHits) PopulateCaloHits(i, caloHitSummary_);
+    }
+    caloHitIdStart_.push_back(caloHitIds_.size());
+  }
+  // Fraction of light speed
+  for (size_t i=0;i<tracks_.size();++i)
+  {
+    if (particleType_[i]==GAMMA) beta_[i]=1.; // Moves at the speed of light
+    else if (energy_[i]==0) beta_[i]=0; // Don't know this if we don't have calo hits
+    else beta_[i]=TMath::Sqrt(energy_[i] * (energy_[i] + 2 * ELECTRON_MASS)) / (energy_[i] +  ELECTRON_MASS);
+  }
+}
+
+void TrackBatch::GetTotalTimeVariances(std::vector<double> &variances, bool projected)
+{
+  EnsureCaloHits();
+  if (projected) EnsureProjectedVertices();
+  const std::vector<double> &lengths = (projected ? projectedLength_ : trackLength_);
+  variances.resize(tracks_.size());
+  for (size_t i=0;i<tracks_.size();++i)
+  {
+    variances[i]=GetTotalTimeVariance(i,lengths[i]);
+  }
+}
+
+double TrackBatch::GetTotalTimeVariance(size_t i, double thisTrackLength)
+{
+  EnsureCaloHits();
+  double totalTimeVariance = 0;
+  if (particleType_[i]==ELECTRON)
+  {
+    double theoreticalTimeOfFlight=thisTrackLength/ (beta_[i] * LIGHT_SPEED);
+    totalTimeVariance = pow(timeSigma_[i],2)
+    + pow(energySigma_[i],2)
+    * pow((theoreticalTimeOfFlight*ELECTRON_MASS*ELECTRON_MASS),2)
+    / pow( (energy_[i] * (energy_[i]+ELECTRON_MASS) * (energy_[i]+ 2 * ELECTRON_MASS) ),2);
+  }
+  if (particleType_[i]==GAMMA)
+  {
+    totalTimeVariance = timeSigma_[i] * timeSigma_[i] + trackLengthSigma_[i] * trackLengthSigma_[i];
+  }
+  return totalTimeVariance;
+}
+
+void TrackBatch::PopulateCaloHits(size_t i, const CaloHitSummary &summary)
+{
+  const snemo::datamodel::particle_track & track = *tracks_[i];
+  time_[i]=summary.firstHitTime_;
+  // We need the uncertainty in the first hit time
+  timeSigma_[i]=summary.firstHitTimeSigma_;
+  energy_[i]=summary.energy_;
+  energySigma_[i]=summary.energySigma_;
+  // Find out which calo wall it hit first. For gammas, the vertex will be set to this calo hit
+  firstHitType_[i]=summary.firstHitType_;
+  firstHitIndex_[i]=summary.firstHitIndex_;
+  // And the fraction of the energy deposited in each wall
+  mainwallFraction_[i]=summary.mainwallEnergy_/summary.energy_;
+  xwallFraction_[i]=summary.xwallEnergy_/summary.energy_;
+  vetoFraction_[i]=summary.vetoEnergy_/summary.energy_;
+
+  if (track.has_vertices()) // There isn't any time ordering to the vertices so check them all
+  {
+    for (unsigned int iVertex=0; iVertex<track.get_vertices().size();++iVertex)
+    {
+      const geomtools::blur_spot & vertex = track.get_vertices().at(iVertex).get();
+      if (snemo::datamodel::particle_track::vertex_is_on_source_foil(vertex) || snemo::datamodel::particle_track::vertex_is_on_wire(vertex) )
+      {
+        flags_[i] |= VERTEX_ON_FOIL; // On wire OR foil - just not calo to calo gammas
+      }
+    }
+  }
+}
+
+// For gammas, the vertex is the position of the calo block that was hit first
+void TrackBatch::SetCaloPositions(const CaloPositionTable* caloPositions)
+{
+  caloPositions_=caloPositions;
+}
+
+void TrackBatch::SetGammaVertex(size_t i)
+{
+  EnsureCaloHits();
+  if (firstHitIndex_[i]<0) return;
+  // The table has every block, so this is just an array read
+  if (caloPositions_ && caloPositions_->GetPosition(caloHitIds_[caloHitIdStart_[i]+firstHitIndex_[i]], vertexX_[i], vertexY_[i], vertexZ_[i])) return;
+  const snemo::datamodel::calibrated_calorimeter_hit & calo_hit = tracks_[i]->get_associated_calorimeter_hits().at(firstHitIndex_[i]).get();
+  geomtools::vector_3d loc (0,0,0);
+  // Get the vertex position
+  const geomtools::mapping & the_mapping = geometry_manager_->get_mapping();
+  // I got this from PTD2root but I don't understand what the two alternatives mean
+  if (! the_mapping.validate_id(calo_hit.get_geom_id())) {
+    std::vector<geomtools::geom_id> gids;
+    the_mapping.compute_matching_geom_id(calo_hit.get_geom_id(), gids); // front calo block = last entry
+    const geomtools::geom_info & info = the_mapping.get_geom_info(gids.back()); // in vector gids
+    loc  = info.get_world_placement().get_translation();
+  }
+  else {
+    const geomtools::geom_info & info = the_mapping.get_geom_info(calo_hit.get_geom_id());
+    loc  = info.get_world_placement().get_translation();
+  }
+  vertexX_[i]=loc.x();
+  vertexY_[i]=loc.y();
+  vertexZ_[i]=loc.z();
+}
+
+// Return true if vertex is on the foil
+// Populate the inner vertex
+bool TrackBatch::SetFoilmostVertex(size_t i)
+{
+  const snemo::datamodel::particle_track & track = *tracks_[i];
+  double closestX=9999;
+  bool hasVertexOnFoil=false;
+
+  if (track.has_vertices()) // There isn't any time ordering to the vertices so check them all
+  {
+    for (unsigned int iVertex=0; iVertex<track.get_vertices().size();++iVertex)
+    {
+      const geomtools::blur_spot & vertex = track.get_vertices().at(iVertex).get();
+      if (snemo::datamodel::particle_track::vertex_is_on_source_foil(vertex) )
+      {
+        hasVertexOnFoil = true;
+      }
+      const geomtools::vector_3d & vertexTranslation = vertex.get_placement().get_translation();
+      // Get details for the vertex nearest the source foil, which is at x = 0
+      if (TMath::Abs(vertexTranslation.x()) < closestX) // this is nearer the foil
+      {
+        closestX=TMath::Abs(vertexTranslation.x());
+        vertexX_[i]=vertexTranslation.x();
+        vertexY_[i]=vertexTranslation.y();
+        vertexZ_[i]=vertexTranslation.z();
+      } // end for each vertex
+    }
+  }
+  return hasVertexOnFoil;
+}
+
+// The wires are parallel to z, so the distance of closest approach is in the xy plane.
+// Helices have their axis along z, so their projection is a circle
+double TrackBatch::GetDistanceFromTrajectory(size_t i, double x, double y) const
+{
+  if (!HasFlag(i,HAS_TRAJECTORY)) return TRACK_NO_VALUE;
+  const snemo::datamodel::base_trajectory_pattern & the_base_pattern = tracks_[i]->get_trajectory().get_pattern();
+  if (the_base_pattern.get_pattern_id()=="line") {
+    const geomtools::line_3d & the_shape = (const geomtools::line_3d&)the_base_pattern.get_shape();
+    geomtools::vector_3d first=the_shape.get_first();
+    geomtools::vector_3d last=the_shape.get_last();
+    double dx=last.x()-first.x();
+    double dy=last.y()-first.y();
+    double lineLength=TMath::Sqrt(dx*dx + dy*dy);
+    if (lineLength==0) return TMath::Sqrt((x-first.x())*(x-first.x()) + (y-first.y())*(y-first.y())); // Parallel to the wire
+    return TMath::Abs(dx*(y-first.y()) - dy*(x-first.x()))/lineLength;
+  }
+  const geomtools::helix_3d & the_shape = (const geomtools::helix_3d&)the_base_pattern.get_shape();
+  const geomtools::vector_3d & center=the_shape.get_center();
+  double fromCenter=TMath::Sqrt((x-center.x())*(x-center.x()) + (y-center.y())*(y-center.y()));
+  return TMath::Abs(fromCenter - the_shape.get_radius());
+}
+
+// Populates the direction with the direction of the track at the foilmost end
+// Returns true if you managed to set it, false if not
+bool TrackBatch::SetDirection(size_t i)
+{
+  if (trackLength_[i]==0 ) return false; // Makes no sense
+
+  const snemo::datamodel::base_trajectory_pattern & the_base_pattern = tracks_[i]->get_trajectory().get_pattern();
+  geomtools::vector_3d foilmost_end;
+  geomtools::vector_3d outermost_end;
+  geomtools::vector_3d direction;
+
+  if (the_base_pattern.get_pattern_id()=="line") {
+    const geomtools::line_3d & the_shape = (const geomtools::line_3d&)the_base_pattern.get_shape();
+    // Find the two ends of the track
+    geomtools::vector_3d one_end=the_shape.get_first();
+    geomtools::vector_3d the_other_end=the_shape.get_last();
+    // which is which?
+    foilmost_end = ((TMath::Abs(one_end.x()) < TMath::Abs(the_other_end.x())) ? one_end: the_other_end);
+    outermost_end = ((TMath::Abs(one_end.x()) >= TMath::Abs(the_other_end.x())) ? one_end: the_other_end);
+    direction = the_shape.get_direction_on_curve(the_shape.get_first()); // Only the first stores the direction for a line track
+  } //end line track
+  else {
+    const geomtools::helix_3d & the_shape = (const geomtools::helix_3d&)the_base_pattern.get_shape();
+    // Find the two ends of the track
+    geomtools::vector_3d one_end=the_shape.get_first();
+    geomtools::vector_3d the_other_end=the_shape.get_last();
+    // which is which?
+    foilmost_end = ((TMath::Abs(one_end.x()) < TMath::Abs(the_other_end.x())) ? one_end: the_other_end);
+    outermost_end = ((TMath::Abs(one_end.x()) >= TMath::Abs(the_other_end.x())) ? one_end: the_other_end);
+    direction = the_shape.get_direction_on_curve(foilmost_end); // Not the same on a curve
+  }// end helix track
+  int multiplier = (direction.x() * outermost_end.x() > 0)? 1: -1; // If the direction points the wrong way, reverse it
+  // This will always point inwards towards the foil. Is that misleading in the case of a track that curves towards the foil and then out again? Not a problem when looking for bb events, but would it be misleading in cases of tracks from the wires?
+  directionX_[i]=direction.x() * multiplier;
+  directionY_[i]=direction.y() * multiplier;
+  directionZ_[i]=direction.z() * multiplier;
+  if(foilmost_end.x() * outermost_end.x() < 0 && TMath::Abs(foilmost_end.x()) > FOIL_CELL_GAP){
+    flags_[i] |= CROSSES_FOIL;
+  }
+  return true;
+}
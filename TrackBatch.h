@@ -0,0 +1,139 @@
+#ifndef TRACKBATCH_HH
+#define TRACKBATCH_HH
+#include "TMath.h"
+#include "TVector3.h"
+
+// - Bayeux
+#include "bayeux/geomtools/manager.h"
+#include "bayeux/geomtools/line_3d.h"
+#include "bayeux/geomtools/helix_3d.h"
+#include "bayeux/geomtools/geomtools.h"
+
+// - Falaise
+#include "falaise/snemo/datamodels/calibrated_data.h"
+#include "falaise/snemo/datamodels/particle_track_data.h"
+
+#include <vector>
+
+#include "CaloHitSummary.h"
+#include "CaloPositionTable.h"
+
+const double ELECTRON_MASS=0.5109989461; // From pdg, in MeV
+const double LIGHT_SPEED=299792458 * 1e-9 * 1000; // Millimeters per nanosecond
+const double FOIL_CELL_GAP=30.838; // From the foil to the first cell in mm
+const double TRACK_NO_VALUE=-9999; // Value of a vertex or direction that could not be calculated
+
+// Track details for every particle in a PTD bank, stored as flat arrays with one entry per particle.
+// Only the particle classification is done when the batch is filled. Each of the other groups of
+// columns (vertices, directions, projections, calo hits) is calculated for all the particles
+// at once, the first time one of the Ensure functions asks for it.
+// Use TrackDetails to look at a single particle in the batch.
+class TrackBatch{
+public:
+  enum Particle { ELECTRON, GAMMA, ALPHA, UNKNOWN };
+  enum Flag {
+    MAKES_TRACK=1<<0, // Charged particle
+    HAS_TRAJECTORY=1<<1, // Charged particle with a fitted trajectory
+    VERTEX_ON_FOIL=1<<2, // On the foil (or for electrons and gammas, on a wire)
+    CROSSES_FOIL=1<<3,
+    HAS_DIRECTION=1<<4,
+    PROJECTS_TO_FOIL=1<<5 // Projected vertex is inside the detector
+  };
+
+  // SuperNEMO constants
+  static const int MAINWALL=CALO_MAINWALL;
+  static const int XWALL=CALO_XWALL;
+  static const int GVETO=CALO_GVETO;
+  static constexpr double MAXY=2505.494; // This is the calo position but maybe it should be the end of the actual foils?
+  static constexpr double MAXZ=1400; // This is not exact! Get the real value!
+
+  TrackBatch();
+  TrackBatch(const geomtools::manager* geometry_manager, const snemo::datamodel::particle_track_data& trackData);
+  // Fill with every particle in the bank. The bank must outlive the batch
+  void Initialize(const geomtools::manager* geometry_manager, const snemo::datamodel::particle_track_data& trackData);
+  // Fill with a single particle. The track must outlive the batch
+  void Initialize(const geomtools::manager* geometry_manager, const snemo::datamodel::particle_track& track);
+  // Set every column to its default value for this many particles
+  void Resize(size_t size);
+  // Empty the batch, keeping the columns' memory for the next event
+  void Clear();
+  size_t GetSize() const;
+  const snemo::datamodel::particle_track& GetTrack(size_t i) const;
+  bool HasFlag(size_t i, Flag flag) const;
+  // Optional: look up gamma vertices in this table instead of the geometry mapping. Not owned
+  void SetCaloPositions(const CaloPositionTable* caloPositions);
+
+  // Calculate a group of columns for all particles, if it hasn't been done yet
+  void EnsureFoilmostVertices();
+  void EnsureDirections();
+  void EnsureProjectedVertices();
+  void EnsureCaloHits();
+
+  // Time variances for every particle, for the track lengths or projected track lengths
+  void GetTotalTimeVariances(std::vector<double> &variances, bool projected);
+  double GetTotalTimeVariance(size_t i, double thisTrackLength);
+  // Distance in the xy plane from a tracker wire at (x, y) to particle i's fitted trajectory,
+  // or TRACK_NO_VALUE if it has no trajectory
+  double GetDistanceFromTrajectory(size_t i, double x, double y) const;
+
+  // Filled on initialization
+  std::vector<int> particleType_;
+  std::vector<int> charge_;
+  std::vector<unsigned int> flags_;
+  std::vector<int> trackerHitCount_;
+  std::vector<double> trackLength_;
+  std::vector<double> trackLengthSigma_;
+  std::vector<double> projectedLength_;
+  std::vector<double> delayTime_;
+
+  // EnsureFoilmostVertices
+  std::vector<double> vertexX_;
+  std::vector<double> vertexY_;
+  std::vector<double> vertexZ_;
+
+  // EnsureDirections: direction at the foilmost end
+  std::vector<double> directionX_;
+  std::vector<double> directionY_;
+  std::vector<double> directionZ_;
+
+  // EnsureProjectedVertices: foil-projected vertex
+  std::vector<double> projectedX_;
+  std::vector<double> projectedY_;
+  std::vector<double> projectedZ_;
+
+  // EnsureCaloHits
+  std::vector<double> energy_;
+  std::vector<double> energySigma_;
+  std::vector<double> time_;
+  std::vector<double> timeSigma_;
+  std::vector<double> mainwallFraction_;
+  std::vector<double> xwallFraction_;
+  std::vector<double> vetoFraction_;
+  std::vector<double> beta_;
+  std::vector<int> firstHitType_;
+  std::vector<int> firstHitIndex_; // Position of the earliest hit in the associated calo hits
+  // These are filled for every particle with associated calo hits, not just electrons and gammas
+  std::vector<double> associatedEnergy_;
+  std::vector<double> associatedEnergyOverThreshold_;
+  std::vector<int> caloHitIds_; // Encoded locations of all associated hits, particle by particle
+  std::vector<size_t> caloHitIdStart_; // Particle i's hits are from caloHitIdStart_[i] to caloHitIdStart_[i+1]
+
+private:
+  const geomtools::manager* geometry_manager_=nullptr;
+  const CaloPositionTable* caloPositions_=nullptr;
+  std::vector<const snemo::datamodel::particle_track*> tracks_; // Not owned: these point into the PTD bank
+
+  bool foilmostVerticesDone_=false;
+  bool directionsDone_=false;
+  bool projectedVerticesDone_=false;
+  bool caloHitsDone_=false;
+
+  void Classify(size_t i);
+  bool SetFoilmostVertex(size_t i);
+  bool SetDirection(size_t i);
+  void SetGammaVertex(size_t i);
+  void PopulateCaloHits(size_t i, const CaloHitSummary &summary);
+  CaloHitSummary caloHitSummary_; // Reused for each particle
+};
+
+#endif // TRACKBATCH_HH
@@ -22,59 +22,34 @@
 #include "falaise/snemo/datamodels/tracker_clustering_solution.h"
 #include "falaise/snemo/datamodels/particle_track_data.h"
 
+#include <memory>
 
-const double ELECTRON_MASS=0.5109989461; // From pdg, in MeV
-const double LIGHT_SPEED=299792458 * 1e-9 * 1000; // Millimeters per nanosecond
-const double FOIL_CELL_GAP=30.838; // From the foil to the first cell in mm
+// The calculations and the storage are in a TrackBatch
+#include "TrackBatch.h"
 
+// View of one particle in a TrackBatch
 class TrackDetails{
-  TVector3 foilmostVertex_ ;
-  TVector3 direction_;
-  bool vertexOnFoil_=false;
-  TVector3 projectedVertex_;
-  enum Particle { ELECTRON, GAMMA, ALPHA, UNKNOWN };
-  Particle particleType_=UNKNOWN;
-  double mainwallFraction_=0;
-  double xwallFraction_=0;
-  double vetoFraction_=0;
-  int firstHitType_=-1;
-  double energy_=0;
-  double energySigma_=0;
-  double time_=0;
-  double timeSigma_=0;
-  int charge_=1;
-  bool makesTrack_=false;
-  snemo::datamodel::particle_track track_;
-  double delayTime_=0 ;
-  int trackerHitCount_= 0;
-  double trackLength_= 0;
-  double trackLengthSigma_=0;
-  double projectedLength_=0;
-  bool crossesFoil_=false;
-  const geomtools::manager* geometry_manager_;
-
-  
-  bool hasTrack_=false;
-  bool SetFoilmostVertex();
-  bool SetDirection();
-  bool SetProjectedVertex();
-  bool PopulateCaloHits();
-  double GetTotalTimeVariance(double thisTrackLength);
-  
+  TrackBatch* batch_=nullptr; // Not owned unless it is ownBatch_
+  size_t index_=0;
+  std::shared_ptr<TrackBatch> ownBatch_; // Only used when we are made from a single track
+
 public:
 
   // SuperNEMO constants
-  int MAINWALL=1302;
-  int XWALL=1232;
-  int GVETO=1252;
-  
-  
-  double MAXY=2505.494; // This is the calo position but maybe it should be the end of the actual foils?
-  double MAXZ=1400; // This is not exact! Get the real value!
-  
+  int MAINWALL=TrackBatch::MAINWALL;
+  int XWALL=TrackBatch::XWALL;
+  int GVETO=TrackBatch::GVETO;
+
+
+  double MAXY=TrackBatch::MAXY; // This is the calo position but maybe it should be the end of the actual foils?
+  double MAXZ=TrackBatch::MAXZ; // This is not exact! Get the real value!
+
   TrackDetails();
-  TrackDetails(const geomtools::manager* geometry_manager_, snemo::datamodel::particle_track track);
-  void Initialize(const geomtools::manager* geometry_manager_,snemo::datamodel::particle_track track);
+  // The track is held by reference, so it must outlive this object (true within one process() call)
+  TrackDetails(const geomtools::manager* geometry_manager_, const snemo::datamodel::particle_track& track);
+  // Look at particle number index in a batch that has already been filled
+  TrackDetails(TrackBatch* batch, size_t index);
+  void Initialize(const geomtools::manager* geometry_manager_, const snemo::datamodel::particle_track& track);
   bool Initialize();
 
   bool IsGamma();
@@ -83,10 +58,10 @@ public:
   bool IsNegativeElectron();
   bool IsPositron();
   bool MakesTrack();
-  
+
   // Charge
   int GetCharge();
-  
+
   // Where did it hit?
   bool HitMainwall();
   bool HitXwall();
@@ -104,7 +79,7 @@ public:
   double GetBeta(); // Fraction of light speed
   double GetProjectedTimeVariance();
   double GetTotalTimeVariance();
-  
+
   // Foilmost vertex
   double GetFoilmostVertexX();
   double GetFoilmostVertexY();
@@ -112,30 +87,29 @@ public:
   TVector3 GetFoilmostVertex();
   bool HasFoilVertex();
   bool TrackCrossesFoil();
-  
+
   // Direction at foilmost end
   double GetDirectionX();
   double GetDirectionY();
   double GetDirectionZ();
   TVector3 GetDirection();
-  
+
   // Foil-projected vertex
   double GetProjectedVertexX();
   double GetProjectedVertexY();
   double GetProjectedVertexZ();
   TVector3 GetProjectedVertex();
-  
+
   // For charged particle tracks
   double GetTrackLength();
   double GetTrackLengthSigma();
   double GetProjectedTrackLength();
   int GetTrackerHitCount();
   double GetDelayTime();
-  
+
   // For gammas, we need an electron track to calculate an assumed length
   double GenerateGammaTrackLengths(TrackDetails *electronTrack);
   TVector3 GenerateGammaTrackDirection(TrackDetails *electronTrack);
   // And the same for alpha projections in a 1e1alpha topology
   bool GenerateAlphaProjections(TrackDetails *electronTrack);
 };
-
@@ -0,0 +1,52 @@
+#include "TrackerCellTable.h"
+
+TrackerCellTable::TrackerCellTable()
+{
+  Clear();
+}
+
+void TrackerCellTable::Clear()
+{
+  x_.assign(TRACKER_CELL_COUNT,0);
+  y_.assign(TRACKER_CELL_COUNT,0);
+  known_.assign(TRACKER_CELL_COUNT,0);
+  filled_=false;
+}
+
+void TrackerCellTable::Build(const geomtools::manager* geometry_manager)
+{
+  Clear();
+  if (!geometry_manager) return;
+  const geomtools::mapping & the_mapping = geometry_manager->get_mapping();
+  for (int index=0;index<TRACKER_CELL_COUNT;++index)
+  {
+    int location=TrackerLocationFromDenseIndex(index);
+    const uint32_t module=0;
+    geomtools::geom_id gid(TRACKER_CELL, module, TrackerDecodeSide(location), TrackerDecodeLayer(location), TrackerDecodeRow(location));
+    try {
+      if (! the_mapping.validate_id(gid)) continue; // Not in this geometry
+      const geomtools::geom_info & info = the_mapping.get_geom_info(gid);
+      geomtools::vector_3d loc = info.get_world_placement().get_translation();
+      x_[index]=loc.x();
+      y_[index]=loc.y();
+      known_[index]=1;
+    } catch (std::logic_error& e) {
+      // Not in this geometry, so leave it unknown
+    }
+  }
+  filled_=true;
+}
+
+bool TrackerCellTable::IsFilled() const
+{
+  return filled_;
+}
+
+bool TrackerCellTable::GetPosition(int location, double &x, double &y) const
+{
+  int index=TrackerDenseIndex(location);
+  if (index<0 || !known_[index]) return false;
+  x=x_[index];
+  y=y_[index];
+  return true;
+}
@@ -0,0 +1,31 @@
+#ifndef TRACKERCELLTABLE_HH
+#define TRACKERCELLTABLE_HH
+// - Bayeux
+#include "bayeux/geomtools/manager.h"
+
+#include <vector>
+
+#include "TrackerLocation.h"
+
+// Wire position (x and y: the wires are parallel to z) of every tracker cell, indexed by the
+// dense tracker index from TrackerLocation.h, so that looking up a cell is an array read.
+// Build it once from the geometry manager
+class TrackerCellTable{
+public:
+  TrackerCellTable();
+  // Look up every cell in the geometry mapping
+  void Build(const geomtools::manager* geometry_manager);
+  void Clear();
+
+  bool IsFilled() const;
+  // Get the wire position of a cell from its encoded location. Returns false if we don't know it
+  bool GetPosition(int location, double &x, double &y) const;
+
+private:
+  std::vector<double> x_;
+  std::vector<double> y_;
+  std::vector<char> known_; // Did we find this cell in the geometry?
+  bool filled_;
+};
+
+#endif // TRACKERCELLTABLE_HH
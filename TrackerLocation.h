@@ -0,0 +1,63 @@
+//! \file    TrackerLocation.h
+//! \brief   Integer encoding of tracker cell locations
+//! \details Header only, with no Falaise dependencies, so that the parser can use it too
+#ifndef TRACKERLOCATION_HH
+#define TRACKERLOCATION_HH
+
+// The encoded location is layer + 100 * row, made negative (and minus 1, so that cell 0 is -1)
+// on the Italy side:
+//   layers are 0 to 8 with 0 being at the source foil and 8 by the main wall
+//   rows go from 0 (mountain) to 112 (tunnel)
+// For example 1203 is France side, row 12, layer 3 and -1204 is the same cell on the Italy side
+
+// geom_id type of a drift cell [module.side.layer.row]
+const int TRACKER_CELL=1204;
+
+const int TRACKER_INVALID_LOCATION=-100000;
+
+const int TRACKER_SIDES=2;
+const int TRACKER_LAYERS=9;
+const int TRACKER_ROWS=113;
+// Every cell has a dense index from 0 to TRACKER_CELL_COUNT-1, for lookup tables
+const int TRACKER_CELL_COUNT=TRACKER_SIDES * TRACKER_LAYERS * TRACKER_ROWS;
+
+constexpr int TrackerEncode(int side, int layer, int row)
+{
+  return (side==0 ? -(layer + 100 * row) - 1 : layer + 100 * row);
+}
+
+// Decoding: each of these assumes a valid location
+constexpr int TrackerDecodeSide(int location) { return (location < 0 ? 0 : 1); }
+constexpr int TrackerDecodeLayer(int location) { return (location < 0 ? -(location + 1) : location) % 100; }
+constexpr int TrackerDecodeRow(int location) { return (location < 0 ? -(location + 1) : location) / 100; }
+
+constexpr bool TrackerIsValid(int location)
+{
+  return (location > TRACKER_INVALID_LOCATION
+          && TrackerDecodeLayer(location) < TRACKER_LAYERS
+          && TrackerDecodeRow(location) < TRACKER_ROWS);
+}
+
+// Dense index from 0 to TRACKER_CELL_COUNT-1, or -1 for an invalid location
+constexpr int TrackerDenseIndex(int location)
+{
+  return (!TrackerIsValid(location) ? -1
+          : (TrackerDecodeSide(location) * TRACKER_LAYERS + TrackerDecodeLayer(location)) * TRACKER_ROWS + TrackerDecodeRow(location));
+}
+
+// The inverse of TrackerDenseIndex
+constexpr int TrackerLocationFromDenseIndex(int index)
+{
+  return (index < 0 || index >= TRACKER_CELL_COUNT ? TRACKER_INVALID_LOCATION
+          : TrackerEncode(index / (TRACKER_LAYERS * TRACKER_ROWS), (index / TRACKER_ROWS) % TRACKER_LAYERS, index % TRACKER_ROWS));
+}
+
+// Checks that the encoding round trips at compile time
+static_assert(TrackerEncode(1, 3, 12)==1203, "France side encoding");
+static_assert(TrackerEncode(0, 3, 12)==-1204, "Italy side encoding");
+static_assert(TrackerDenseIndex(TrackerLocationFromDenseIndex(0))==0, "First dense index");
+static_assert(TrackerDenseIndex(TrackerLocationFromDenseIndex(1000))==1000, "Middle dense index");
+static_assert(TrackerDenseIndex(TrackerLocationFromDenseIndex(TRACKER_CELL_COUNT - 1))==TRACKER_CELL_COUNT - 1, "Last dense index");
+static_assert(TrackerDenseIndex(TrackerEncode(1, 9, 0))==-1, "Invalid layer");
+
+#endif // TRACKERLOCATION_HH
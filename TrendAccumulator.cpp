@@ -0,0 +1,178 @@
+#include "TrendAccumulator.h"
+#include "TBranch.h"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+TrendAccumulator::TrendAccumulator() : keyWidth_(1)
+{}
+
+void TrendAccumulator::Initialize(const std::string &treeName, const std::string &keyName, Long64_t keyWidth)
+{
+  treeName_=treeName;
+  keyName_=keyName;
+  keyWidth_=(keyWidth>1 ? keyWidth : 1);
+  totals_.clear();
+}
+
+// The totals for a key that has already been rounded, starting them if they are new
+TrendAccumulator::Totals& TrendAccumulator::GetTotals(Long64_t key)
+{
+  std::map<Long64_t,Totals>::iterator found=totals_.find(key);
+  if (found!=totals_.end()) return found->second;
+  const size_t quantityCount=GetScalarQuantities().size();
+  Totals &totals=totals_[key];
+  totals.sums_.assign(quantityCount,0);
+  totals.sumSquares_.assign(quantityCount,0);
+  totals.mins_.assign(quantityCount,std::numeric_limits<double>::infinity());
+  totals.maxes_.assign(quantityCount,-std::numeric_limits<double>::infinity());
+  return totals;
+}
+
+void TrendAccumulator::Fill(Long64_t key, const ValidationEventStorage &event)
+{
+  if (keyWidth_>1) key-=((key%keyWidth_)+keyWidth_)%keyWidth_; // Round down, even below 0
+  Totals &totals=GetTotals(key);
+  ++totals.count_;
+  const std::vector<ScalarQuantity> &quantities=GetScalarQuantities();
+  for (size_t quantity=0;quantity<quantities.size();++quantity)
+  {
+    double value=quantities[quantity].GetValue(event);
+    totals.sums_[quantity]+=value;
+    totals.sumSquares_[quantity]+=value*value;
+    totals.mins_[quantity]=std::min(totals.mins_[quantity],value);
+    totals.maxes_[quantity]=std::max(totals.maxes_[quantity],value);
+  }
+}
+
+void TrendAccumulator::Merge(const TrendAccumulator &other)
+{
+  for (const std::pair<const Long64_t,Totals> &entry : other.totals_)
+  {
+    Totals &totals=GetTotals(entry.first);
+    totals.count_+=entry.second.count_;
+    for (size_t quantity=0;quantity<totals.sums_.size() && quantity<entry.second.sums_.size();++quantity)
+    {
+      totals.sums_[quantity]+=entry.second.sums_[quantity];
+      totals.sumSquares_[quantity]+=entry.second.sumSquares_[quantity];
+      totals.mins_[quantity]=std::min(totals.mins_[quantity],entry.second.mins_[quantity]);
+      totals.maxes_[quantity]=std::max(totals.maxes_[quantity],entry.second.maxes_[quantity]);
+    }
+  }
+}
+
+void TrendAccumulator::Clear()
+{
+  totals_.clear();
+}
+
+void TrendAccumulator::Write(TDirectory *directory) const
+{
+  directory->cd();
+  TTree *tree = new TTree(treeName_.c_str(),("h_ quantities by "+keyName_).c_str());
+  tree->SetDirectory(directory);
+  Long64_t key;
+  Long64_t keyWidth=keyWidth_;
+  Long64_t count;
+  const std::vector<ScalarQuantity> &quantities=GetScalarQuantities();
+  std::vector<double> sums(quantities.size());
+  std::vector<double> sumSquares(quantities.size());
+  std::vector<double> mins(quantities.size());
+  std::vector<double> maxes(quantities.size());
+  tree->Branch(keyName_.c_str(),&key);
+  if (keyWidth_>1) tree->Branch((keyName_+"_width").c_str(),&keyWidth);
+  tree->Branch("count",&count);
+  for (size_t quantity=0;quantity<quantities.size();++quantity)
+  {
+    std::string name=quantities[quantity].name_;
+    tree->Branch((name+"_sum").c_str(),&sums[quantity]);
+    tree->Branch((name+"_sum2").c_str(),&sumSquares[quantity]);
+    tree->Branch((name+"_min").c_str(),&mins[quantity]);
+    tree->Branch((name+"_max").c_str(),&maxes[quantity]);
+  }
+  for (const std::pair<const Long64_t,Totals> &entry : totals_)
+  {
+    key=entry.first;
+    count=entry.second.count_;
+    sums=entry.second.sums_; // Same sizes, so the branch addresses don't move
+    sumSquares=entry.second.sumSquares_;
+    mins=entry.second.mins_;
+    maxes=entry.second.maxes_;
+    tree->Fill();
+  }
+  tree->Write("",TObject::kOverwrite);
+  delete tree;
+}
+
+// Quantities are matched by name, so a quantity that isn't in the tree just gets nothing added
+bool TrendAccumulator::Read(TDirectory *directory)
+{
+  TTree *tree=nullptr;
+  if (directory) directory->GetObject(treeName_.c_str(),tree);
+  if (!tree) return false;
+  Long64_t key;
+  Long64_t keyWidth=1;
+  Long64_t count;
+  const std::vector<ScalarQuantity> &quantities=GetScalarQuantities();
+  std::vector<double> sums(quantities.size(),0);
+  std::vector<double> sumSquares(quantities.size(),0);
+  std::vector<double> mins(quantities.size(),std::numeric_limits<double>::infinity());
+  std::vector<double> maxes(quantities.size(),-std::numeric_limits<double>::infinity());
+  // Check every entry's width before adding any of them, so that a mismatch leaves the totals as they were
+  TBranch *widthBranch=tree->GetBranch((keyName_+"_width").c_str());
+  if (widthBranch) tree->SetBranchAddress((keyName_+"_width").c_str(),&keyWidth);
+  for (Long64_t entry=0;entry<tree->GetEntries();++entry)
+  {
+    if (widthBranch) widthBranch->GetEntry(entry);
+    if (keyWidth!=keyWidth_)
+    {
+      std::cerr << treeName_ << " has a " << keyName_ << " width of " << keyWidth << ", not " << keyWidth_ << std::endl;
+      tree->ResetBranchAddresses();
+      return false;
+    }
+  }
+  tree->SetBranchAddress(keyName_.c_str(),&key);
+  tree->SetBranchAddress("count",&count);
+  for (size_t quantity=0;quantity<quantities.size();++quantity)
+  {
+    std::string name=quantities[quantity].name_;
+    if (!tree->GetBranch((name+"_sum").c_str())) continue;
+    tree->SetBranchAddress((name+"_sum").c_str(),&sums[quantity]);
+    tree->SetBranchAddress((name+"_sum2").c_str(),&sumSquares[quantity]);
+    tree->SetBranchAddress((name+"_min").c_str(),&mins[quantity]);
+    tree->SetBranchAddress((name+"_max").c_str(),&maxes[quantity]);
+  }
+  for (Long64_t entry=0;entry<tree->GetEntries();++entry)
+  {
+    tree->GetEntry(entry);
+    Totals &totals=GetTotals(key);
+    totals.count_+=count;
+    for (size_t quantity=0;quantity<quantities.size();++quantity)
+    {
+      totals.sums_[quantity]+=sums[quantity];
+      totals.sumSquares_[quantity]+=sumSquares[quantity];
+      totals.mins_[quantity]=std::min(totals.mins_[quantity],mins[quantity]);
+      totals.maxes_[quantity]=std::max(totals.maxes_[quantity],maxes[quantity]);
+    }
+  }
+  tree->ResetBranchAddresses();
+  return true;
+}
+
+const std::string& TrendAccumulator::GetTreeName() const
+{
+  return treeName_;
+}
+
+Long64_t TrendAccumulator::GetKeyWidth() const
+{
+  return keyWidth_;
+}
+
+size_t TrendAccumulator::GetMemoryBytes() const
+{
+  // Four numbers per quantity per key, plus roughly a map node each
+  const size_t quantityCount=GetScalarQuantities().size();
+  return totals_.size()*(sizeof(Totals)+4*quantityCount*sizeof(double)+4*sizeof(void*));
+}
@@ -0,0 +1,52 @@
+#ifndef TRENDACCUMULATOR_HH
+#define TRENDACCUMULATOR_HH
+#include "TDirectory.h"
+#include "TTree.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ValidationEventStorage.h"
+
+// Running totals of every h_ quantity for each value of a key, like the run number or the time
+// bucket an event is in: the number of events, and the sum, sum of squares, minimum and maximum of
+// each quantity. Written as a small tree with one entry per key value, so that trends can be
+// plotted without reading the Validation tree, and files can be merged by adding up the entries
+class TrendAccumulator{
+public:
+  TrendAccumulator();
+  // keyName is the name of the key's branch. With a keyWidth of more than 1, keys are rounded down
+  // to a multiple of it (e.g. timestamps into buckets), and it is written in a <keyName>_width branch
+  void Initialize(const std::string &treeName, const std::string &keyName, Long64_t keyWidth);
+  void Fill(Long64_t key, const ValidationEventStorage &event);
+  // Add the totals from another accumulator with the same key
+  void Merge(const TrendAccumulator &other);
+  void Clear();
+  // Branches are the key and count, then <quantity>_sum, <quantity>_sum2, <quantity>_min and
+  // <quantity>_max for each h_ quantity. It replaces any tree of the same name in the directory
+  void Write(TDirectory *directory) const;
+  // Add the totals from a tree written by Write. Returns false if there isn't one, or its key width is different
+  bool Read(TDirectory *directory);
+
+  const std::string& GetTreeName() const;
+  Long64_t GetKeyWidth() const;
+  size_t GetMemoryBytes() const;
+
+private:
+  struct Totals{
+    Long64_t count_=0;
+    std::vector<double> sums_; // One entry per h_ quantity, in the order of GetScalarQuantities()
+    std::vector<double> sumSquares_;
+    std::vector<double> mins_;
+    std::vector<double> maxes_;
+  };
+  std::string treeName_;
+  std::string keyName_;
+  Long64_t keyWidth_;
+  std::map<Long64_t,Totals> totals_; // By key, so the tree is in key order
+
+  Totals& GetTotals(Long64_t key);
+};
+
+#endif // TRENDACCUMULATOR_HH
@@ -0,0 +1,335 @@
+#include "ValidationAccumulators.h"
+#include "TKey.h"
+#include "TList.h"
+
+#include "CaloLocation.h"
+#include "TrackerLocation.h"
+
+#include <algorithm>
+#include <iostream>
+
+ValidationAccumulators::ValidationAccumulators() : accumulateMaps_(false), quantileSketches_(false), eventCount_(0), runSummary_(false), timeBucketSeconds_(0)
+{}
+
+void ValidationAccumulators::Initialize(bool accumulateMaps, const std::vector<std::string> &caloBandNames,
+                                        bool quantileSketches, double sketchAccuracy, bool runSummary, Long64_t timeBucketSeconds)
+{
+  accumulateMaps_=accumulateMaps;
+  quantileSketches_=quantileSketches;
+  eventCount_=0;
+  // Set up an accumulator for each map branch, with the value branches that pair with it
+  if (accumulateMaps_)
+  {
+    trackerHitMap_.Initialize("t_cell_hit_count",{"tm_average_drift_radius"},TRACKER_CELL_COUNT,TrackerDenseIndex,TrackerLocationFromDenseIndex);
+    trackHitMap_.Initialize("t_track_cell_hit_map",{"tm_track_drift_radius","tm_trajectory_distance","tm_drift_radius_residual"},
+                            TRACKER_CELL_COUNT,TrackerDenseIndex,TrackerLocationFromDenseIndex);
+    caloHitMap_.Initialize("c_calorimeter_hit_map",{"cm_average_calorimeter_energy"},CALO_BLOCK_COUNT,CaloDenseIndex,CaloLocationFromDenseIndex);
+    caloBackscatterMap_.Initialize("c_calorimeter_hit_map_backscatter",{},CALO_BLOCK_COUNT,CaloDenseIndex,CaloLocationFromDenseIndex);
+    caloBandMaps_.assign(caloBandNames.size(),MapAccumulator());
+    for (size_t band=0;band<caloBandNames.size();++band)
+    {
+      caloBandMaps_.at(band).Initialize("c_calorimeter_hit_map_"+caloBandNames.at(band),{},CALO_BLOCK_COUNT,CaloDenseIndex,CaloLocationFromDenseIndex);
+    }
+  }
+  sketches_.clear();
+  if (quantileSketches_) sketches_.assign(GetScalarQuantities().size(),QuantileSketch(sketchAccuracy));
+  runSummary_=runSummary;
+  timeBucketSeconds_=(timeBucketSeconds>0 ? timeBucketSeconds : 0);
+  runTrend_.Initialize("RunSummary","run",1);
+  timeTrend_.Initialize("TimeSummary","time",timeBucketSeconds_);
+}
+
+// The band names come from the map trees' names, and the accuracy from the first sketch
+bool ValidationAccumulators::InitializeFrom(TDirectory *directory)
+{
+  std::vector<std::string> caloBandNames;
+  TDirectory *mapDirectory=directory->GetDirectory("Maps");
+  if (mapDirectory)
+  {
+    const std::string bandPrefix="c_calorimeter_hit_map_";
+    TIter next(mapDirectory->GetListOfKeys());
+    while (TKey *key=(TKey*)next())
+    {
+      std::string name=key->GetName();
+      if (name.compare(0,bandPrefix.size(),bandPrefix)!=0 || name==bandPrefix+"backscatter") continue;
+      std::string band=name.substr(bandPrefix.size());
+      if (std::find(caloBandNames.begin(),caloBandNames.end(),band)==caloBandNames.end()) caloBandNames.push_back(band);
+    }
+  }
+  double sketchAccuracy=0.01;
+  TTree *sketchTree=nullptr;
+  directory->GetObject("Sketches",sketchTree);
+  if (sketchTree && sketchTree->GetEntries()>0)
+  {
+    sketchTree->SetBranchAddress("relative_accuracy",&sketchAccuracy);
+    sketchTree->GetEntry(0);
+    sketchTree->ResetBranchAddresses();
+  }
+  TTree *runTree=nullptr;
+  directory->GetObject("RunSummary",runTree);
+  // Buckets of more than a second have their width in every entry
+  Long64_t timeBucketSeconds=0;
+  TTree *timeTree=nullptr;
+  directory->GetObject("TimeSummary",timeTree);
+  if (timeTree)
+  {
+    timeBucketSeconds=1;
+    if (timeTree->GetEntries()>0 && timeTree->GetBranch("time_width"))
+    {
+      timeTree->SetBranchAddress("time_width",&timeBucketSeconds);
+      timeTree->GetEntry(0);
+      timeTree->ResetBranchAddresses();
+    }
+  }
+  Initialize(mapDirectory!=nullptr,caloBandNames,sketchTree!=nullptr,sketchAccuracy,runTree!=nullptr,timeBucketSeconds);
+  directory->cd();
+  return (mapDirectory || sketchTree || runTree || timeTree);
+}
+
+void ValidationAccumulators::Fill(const ValidationEventStorage &event)
+{
+  ++eventCount_;
+  if (accumulateMaps_)
+  {
+    trackerHitMap_.Fill(event.t_cell_hit_count_,{&event.tm_average_drift_radius_});
+    trackHitMap_.Fill(event.t_track_cell_hit_map_,
+                      {&event.tm_track_drift_radius_,&event.tm_trajectory_distance_,&event.tm_drift_radius_residual_});
+    caloHitMap_.Fill(event.c_calorimeter_hit_map_,{&event.cm_average_calorimeter_energy_});
+    caloBackscatterMap_.Fill(event.c_calorimeter_hit_map_backscatter_,{});
+    for (size_t band=0;band<caloBandMaps_.size() && band<event.c_calorimeter_hit_map_bands_.size();++band)
+    {
+      caloBandMaps_.at(band).Fill(event.c_calorimeter_hit_map_bands_.at(band),{});
+    }
+  }
+  const std::vector<ScalarQuantity> &quantities=GetScalarQuantities();
+  for (size_t quantity=0;quantity<sketches_.size();++quantity)
+  {
+    sketches_[quantity].Add(quantities[quantity].GetValue(event));
+  }
+  if (runSummary_ && event.run_number_>=0) runTrend_.Fill(event.run_number_,event);
+  if (HasTimeSummary() && event.timestamp_>=0) timeTrend_.Fill(event.timestamp_,event);
+}
+
+void ValidationAccumulators::Merge(const ValidationAccumulators &other)
+{
+  eventCount_+=other.eventCount_;
+  if (accumulateMaps_ && other.accumulateMaps_)
+  {
+    trackerHitMap_.Merge(other.trackerHitMap_);
+    trackHitMap_.Merge(other.trackHitMap_);
+    caloHitMap_.Merge(other.caloHitMap_);
+    caloBackscatterMap_.Merge(other.caloBackscatterMap_);
+    for (size_t band=0;band<caloBandMaps_.size() && band<other.caloBandMaps_.size();++band)
+    {
+      caloBandMaps_.at(band).Merge(other.caloBandMaps_.at(band));
+    }
+  }
+  for (size_t quantity=0;quantity<sketches_.size() && quantity<other.sketches_.size();++quantity)
+  {
+    sketches_[quantity].Merge(other.sketches_[quantity]);
+  }
+  if (runSummary_ && other.runSummary_) runTrend_.Merge(other.runTrend_);
+  if (HasTimeSummary() && other.timeBucketSeconds_==timeBucketSeconds_) timeTrend_.Merge(other.timeTrend_);
+}
+
+void ValidationAccumulators::Clear()
+{
+  eventCount_=0;
+  trackerHitMap_.Clear();
+  trackHitMap_.Clear();
+  caloHitMap_.Clear();
+  caloBackscatterMap_.Clear();
+  for (size_t band=0;band<caloBandMaps_.size();++band) caloBandMaps_.at(band).Clear();
+  for (size_t quantity=0;quantity<sketches_.size();++quantity) sketches_[quantity].Clear();
+  runTrend_.Clear();
+  timeTrend_.Clear();
+}
+
+void ValidationAccumulators::Write(TDirectory *directory) const
+{
+  if (accumulateMaps_)
+  {
+    // One tree per map, in a Maps directory
+    TDirectory *mapDirectory=directory->GetDirectory("Maps");
+    if (!mapDirectory) mapDirectory=directory->mkdir("Maps");
+    trackerHitMap_.Write(mapDirectory);
+    trackHitMap_.Write(mapDirectory);
+    caloHitMap_.Write(mapDirectory);
+    caloBackscatterMap_.Write(mapDirectory);
+    for (size_t band=0;band<caloBandMaps_.size();++band) caloBandMaps_.at(band).Write(mapDirectory);
+  }
+  if (quantileSketches_) WriteSketches(directory);
+  if (runSummary_) runTrend_.Write(directory);
+  if (HasTimeSummary()) timeTrend_.Write(directory);
+  directory->cd();
+}
+
+// One entry per h_ quantity. The buckets are there so sketches from different files can be merged,
+// and a few standard quantiles are there so you don't have to
+void ValidationAccumulators::WriteSketches(TDirectory *directory) const
+{
+  directory->cd();
+  TTree *tree = new TTree("Sketches","Quantile sketches of the h_ quantities");
+  tree->SetDirectory(directory);
+  std::string name;
+  double relativeAccuracy;
+  Long64_t count;
+  Long64_t zeroCount;
+  double min, max, sum;
+  std::vector<int> positiveIndices, negativeIndices;
+  std::vector<Long64_t> positiveCounts, negativeCounts;
+  std::vector<double> quantileLevels={0.01,0.05,0.16,0.25,0.5,0.75,0.84,0.95,0.99};
+  std::vector<double> quantiles(quantileLevels.size());
+  tree->Branch("name",&name);
+  tree->Branch("relative_accuracy",&relativeAccuracy);
+  tree->Branch("count",&count);
+  tree->Branch("zero_count",&zeroCount);
+  tree->Branch("min",&min);
+  tree->Branch("max",&max);
+  tree->Branch("sum",&sum);
+  tree->Branch("positive_indices",&positiveIndices);
+  tree->Branch("positive_counts",&positiveCounts);
+  tree->Branch("negative_indices",&negativeIndices);
+  tree->Branch("negative_counts",&negativeCounts);
+  tree->Branch("quantile_levels",&quantileLevels);
+  tree->Branch("quantiles",&quantiles);
+  const std::vector<ScalarQuantity> &quantities=GetScalarQuantities();
+  for (size_t quantity=0;quantity<sketches_.size();++quantity)
+  {
+    const QuantileSketch &sketch=sketches_[quantity];
+    name=quantities[quantity].name_;
+    relativeAccuracy=sketch.GetRelativeAccuracy();
+    count=sketch.GetCount();
+    zeroCount=sketch.GetZeroCount();
+    min=sketch.GetMin();
+    max=sketch.GetMax();
+    sum=sketch.GetSum();
+    sketch.GetBuckets(false,positiveIndices,positiveCounts);
+    sketch.GetBuckets(true,negativeIndices,negativeCounts);
+    for (size_t level=0;level<quantileLevels.size();++level) quantiles[level]=sketch.GetQuantile(quantileLevels[level]);
+    tree->Fill();
+  }
+  tree->Write("",TObject::kOverwrite);
+  delete tree;
+}
+
+bool ValidationAccumulators::Read(TDirectory *directory)
+{
+  bool found=true;
+  if (accumulateMaps_)
+  {
+    TDirectory *mapDirectory=directory->GetDirectory("Maps");
+    found=trackerHitMap_.Read(mapDirectory) && found;
+    found=trackHitMap_.Read(mapDirectory) && found;
+    found=caloHitMap_.Read(mapDirectory) && found;
+    found=caloBackscatterMap_.Read(mapDirectory) && found;
+    for (size_t band=0;band<caloBandMaps_.size();++band) found=caloBandMaps_.at(band).Read(mapDirectory) && found;
+  }
+  if (quantileSketches_) found=ReadSketches(directory) && found;
+  if (runSummary_) found=runTrend_.Read(directory) && found;
+  if (HasTimeSummary()) found=timeTrend_.Read(directory) && found;
+  directory->cd();
+  return found;
+}
+
+// Sketches are matched to the h_ quantities by name, and must have the same accuracy
+bool ValidationAccumulators::ReadSketches(TDirectory *directory)
+{
+  TTree *tree=nullptr;
+  directory->GetObject("Sketches",tree);
+  if (!tree)
+  {
+    std::cerr << "No Sketches tree to read" << std::endl;
+    return false;
+  }
+  std::string *name=nullptr;
+  double relativeAccuracy;
+  Long64_t zeroCount;
+  double min, max, sum;
+  std::vector<int> *positiveIndices=nullptr, *negativeIndices=nullptr;
+  std::vector<Long64_t> *positiveCounts=nullptr, *negativeCounts=nullptr;
+  tree->SetBranchAddress("name",&name);
+  tree->SetBranchAddress("relative_accuracy",&relativeAccuracy);
+  tree->SetBranchAddress("zero_count",&zeroCount);
+  tree->SetBranchAddress("min",&min);
+  tree->SetBranchAddress("max",&max);
+  tree->SetBranchAddress("sum",&sum);
+  tree->SetBranchAddress("positive_indices",&positiveIndices);
+  tree->SetBranchAddress("positive_counts",&positiveCounts);
+  tree->SetBranchAddress("negative_indices",&negativeIndices);
+  tree->SetBranchAddress("negative_counts",&negativeCounts);
+  const std::vector<ScalarQuantity> &quantities=GetScalarQuantities();
+  bool ok=true;
+  Long64_t eventsRead=0; // Every event adds one value to each sketch
+  for (Long64_t entry=0;entry<tree->GetEntries();++entry)
+  {
+    tree->GetEntry(entry);
+    size_t quantity=0;
+    while (quantity<quantities.size() && *name!=quantities[quantity].name_) ++quantity;
+    if (quantity>=sketches_.size()) continue; // A quantity we don't have any more
+    // Merging checks the accuracy, so build the sketch on its own first
+    QuantileSketch sketch(relativeAccuracy);
+    sketch.AddBuckets(false,*positiveIndices,*positiveCounts);
+    sketch.AddBuckets(true,*negativeIndices,*negativeCounts);
+    sketch.AddSummary(zeroCount,min,max,sum);
+    eventsRead=sketch.GetCount();
+    if (!sketches_[quantity].Merge(sketch))
+    {
+      std::cerr << "The sketch of " << *name << " has a different relative accuracy" << std::endl;
+      ok=false;
+    }
+  }
+  eventCount_+=eventsRead;
+  tree->ResetBranchAddresses();
+  delete name;
+  delete positiveIndices;
+  delete negativeIndices;
+  delete positiveCounts;
+  delete negativeCounts;
+  delete tree;
+  return ok;
+}
+
+bool ValidationAccumulators::HasMaps() const
+{
+  return accumulateMaps_;
+}
+
+bool ValidationAccumulators::HasSketches() const
+{
+  return quantileSketches_;
+}
+
+bool ValidationAccumulators::HasRunSummary() const
+{
+  return runSummary_;
+}
+
+bool ValidationAccumulators::HasTimeSummary() const
+{
+  return (timeBucketSeconds_>0);
+}
+
+Long64_t ValidationAccumulators::GetEventCount() const
+{
+  return eventCount_;
+}
+
+const QuantileSketch& ValidationAccumulators::GetSketch(size_t quantity) const
+{
+  return sketches_.at(quantity);
+}
+
+size_t ValidationAccumulators::GetMemoryBytes() const
+{
+  size_t bytes=0;
+  if (accumulateMaps_)
+  {
+    bytes+=trackerHitMap_.GetMemoryBytes()+trackHitMap_.GetMemoryBytes();
+    bytes+=caloHitMap_.GetMemoryBytes()+caloBackscatterMap_.GetMemoryBytes();
+    for (size_t band=0;band<caloBandMaps_.size();++band) bytes+=caloBandMaps_.at(band).GetMemoryBytes();
+  }
+  for (size_t quantity=0;quantity<sketches_.size();++quantity) bytes+=sketches_[quantity].GetMemoryBytes();
+  bytes+=runTrend_.GetMemoryBytes()+timeTrend_.GetMemoryBytes();
+  return bytes;
+}
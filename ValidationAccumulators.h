@@ -0,0 +1,72 @@
+#ifndef VALIDATIONACCUMULATORS_HH
+#define VALIDATIONACCUMULATORS_HH
+#include "TDirectory.h"
+#include "TTree.h"
+
+#include <string>
+#include <vector>
+
+#include "ValidationEventStorage.h"
+#include "MapAccumulator.h"
+#include "QuantileSketch.h"
+#include "TrendAccumulator.h"
+
+// Everything the module adds up over a whole job, rather than writing per event:
+// the tracker and calorimeter maps, a quantile sketch for each h_ quantity, and the totals of
+// each h_ quantity per run and per time bucket.
+// None of it depends on the order of the events, so accumulators from different jobs
+// (or different parts of one job) can be merged
+class ValidationAccumulators{
+public:
+  ValidationAccumulators();
+  // caloBandNames are the names of the calorimeter energy band maps. The time buckets are
+  // timeBucketSeconds long, or there are none if it is 0
+  void Initialize(bool accumulateMaps, const std::vector<std::string> &caloBandNames,
+                  bool quantileSketches, double sketchAccuracy, bool runSummary, Long64_t timeBucketSeconds);
+  // Set up with the settings of the accumulators that Write put in a directory, so that files can be
+  // merged without knowing how they were made. Returns false if there aren't any
+  bool InitializeFrom(TDirectory *directory);
+  // Add one event
+  void Fill(const ValidationEventStorage &event);
+  // Add another set of accumulators that was initialized with the same settings
+  void Merge(const ValidationAccumulators &other);
+  // Set all the totals back to zero, keeping the settings
+  void Clear();
+  // The maps go in a Maps directory, the sketches in a Sketches tree and the trends in RunSummary and
+  // TimeSummary trees, replacing any that are there already
+  void Write(TDirectory *directory) const;
+  // Add the maps and sketches from a directory written by Write. The event count comes from the
+  // sketches, if there are any. Returns false if anything that should be there is missing
+  bool Read(TDirectory *directory);
+
+  bool HasMaps() const;
+  bool HasSketches() const;
+  bool HasRunSummary() const;
+  bool HasTimeSummary() const;
+  Long64_t GetEventCount() const;
+  size_t GetMemoryBytes() const;
+  const QuantileSketch& GetSketch(size_t quantity) const; // In the order of GetScalarQuantities()
+
+private:
+  bool accumulateMaps_;
+  bool quantileSketches_;
+  Long64_t eventCount_;
+
+  MapAccumulator trackerHitMap_;
+  MapAccumulator trackHitMap_;
+  MapAccumulator caloHitMap_;
+  MapAccumulator caloBackscatterMap_;
+  std::vector<MapAccumulator> caloBandMaps_;
+
+  std::vector<QuantileSketch> sketches_; // One per h_ quantity
+
+  bool runSummary_;
+  Long64_t timeBucketSeconds_;
+  TrendAccumulator runTrend_; // By the run number in the event header, for events that have one
+  TrendAccumulator timeTrend_; // By the time bucket of the event header's timestamp, if the time bucket is more than 0
+
+  void WriteSketches(TDirectory *directory) const;
+  bool ReadSketches(TDirectory *directory);
+};
+
+#endif // VALIDATIONACCUMULATORS_HH
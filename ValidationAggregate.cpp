@@ -0,0 +1,288 @@
+#include "ValidationAggregate.h"
+#include "TChain.h"
+#include "TFile.h"
+#include "TKey.h"
+#include "TList.h"
+#include "TTree.h"
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <set>
+
+#include "ValidationMerger.h"
+
+namespace {
+  // Trees that ValidationAccumulators writes, which are added up rather than chained
+  const std::set<std::string> ACCUMULATOR_TREES={"Sketches","RunSummary","TimeSummary"};
+
+  // The chain and the entry lists' sub-lists must name the files in the same way
+  std::string GetAbsolutePath(const std::string &fileName)
+  {
+    char path[PATH_MAX];
+    if (!realpath(fileName.c_str(),path)) return fileName;
+    return path;
+  }
+}
+
+ValidationAggregate::ValidationAggregate(const std::string &fileName) : fileName_(fileName), hasAccumulators_(false), addedCount_(0)
+{}
+
+ValidationAggregate::~ValidationAggregate()
+{
+  Clear();
+}
+
+void ValidationAggregate::Clear()
+{
+  keys_.clear();
+  treeNames_.clear();
+  hasAccumulators_=false;
+  accumulators_=ValidationAccumulators();
+  for (std::pair<const std::string,TH1*> &histogram : histograms_) delete histogram.second;
+  histograms_.clear();
+  for (std::pair<const std::string,TEntryList*> &entries : entryLists_) delete entries.second;
+  entryLists_.clear();
+}
+
+bool ValidationAggregate::Open()
+{
+  Clear();
+  std::unique_ptr<TFile> file(TFile::Open(fileName_.c_str(),"READ"));
+  if (!file || file->IsZombie()) return true; // Nothing saved yet
+  TTree *keyTree=nullptr;
+  file->GetObject("Keys",keyTree);
+  if (!keyTree)
+  {
+    std::cerr << "No Keys tree in " << fileName_ << std::endl;
+    return false;
+  }
+  std::string *key=nullptr, *outputFile=nullptr;
+  keyTree->SetBranchAddress("key",&key);
+  keyTree->SetBranchAddress("file",&outputFile);
+  for (Long64_t entry=0;entry<keyTree->GetEntries();++entry)
+  {
+    keyTree->GetEntry(entry);
+    keys_[*key]=*outputFile;
+  }
+  keyTree->ResetBranchAddresses();
+  delete key;
+  delete outputFile;
+  TTree *treeNameTree=nullptr;
+  file->GetObject("Trees",treeNameTree);
+  if (treeNameTree)
+  {
+    std::string *treeName=nullptr;
+    treeNameTree->SetBranchAddress("name",&treeName);
+    for (Long64_t entry=0;entry<treeNameTree->GetEntries();++entry)
+    {
+      treeNameTree->GetEntry(entry);
+      treeNames_.insert(*treeName);
+    }
+    treeNameTree->ResetBranchAddresses();
+    delete treeName;
+  }
+  hasAccumulators_=accumulators_.InitializeFrom(file.get());
+  if (hasAccumulators_ && !accumulators_.Read(file.get()))
+  {
+    std::cerr << "Could not read the maps and sketches from " << fileName_ << std::endl;
+    Clear();
+    return false;
+  }
+  TDirectory *histogramDirectory=file->GetDirectory("Histograms");
+  if (histogramDirectory)
+  {
+    TIter next(histogramDirectory->GetListOfKeys());
+    while (TKey *histogramKey=(TKey*)next())
+    {
+      TH1 *histogram=nullptr;
+      histogramDirectory->GetObject(histogramKey->GetName(),histogram);
+      if (!histogram || histograms_.count(histogram->GetName())) continue;
+      histogram->SetDirectory(nullptr);
+      histograms_[histogram->GetName()]=histogram;
+    }
+  }
+  for (const std::string &name : ValidationMerger::GetEntryListNames())
+  {
+    TEntryList *entries=nullptr;
+    file->GetObject(name.c_str(),entries);
+    if (!entries) continue;
+    entries->SetDirectory(nullptr);
+    entryLists_[name]=entries;
+  }
+  return true;
+}
+
+bool ValidationAggregate::Update(const std::vector<std::string> &keys, const std::vector<std::string> &outputFiles)
+{
+  std::map<std::string,std::string> wanted;
+  for (size_t i=0;i<keys.size();++i) wanted[keys[i]]=GetAbsolutePath(outputFiles.at(i));
+  for (const std::pair<const std::string,std::string> &added : keys_)
+  {
+    std::map<std::string,std::string>::const_iterator found=wanted.find(added.first);
+    if (found==wanted.end() || found->second!=added.second)
+    {
+      std::clog << "An input has changed or gone since the last run: adding up the cached outputs again" << std::endl;
+      Clear();
+      break;
+    }
+  }
+  addedCount_=0;
+  for (const std::pair<const std::string,std::string> &output : wanted)
+  {
+    if (keys_.count(output.first)) continue;
+    if (!Add(output.first,output.second)) return false;
+    ++addedCount_;
+  }
+  return true;
+}
+
+// Add one cached output to the totals
+bool ValidationAggregate::Add(const std::string &key, const std::string &outputFile)
+{
+  std::unique_ptr<TFile> file(TFile::Open(outputFile.c_str(),"READ"));
+  if (!file || file->IsZombie())
+  {
+    std::cerr << "Could not open " << outputFile << std::endl;
+    return false;
+  }
+  // Every output was made with the same settings, so the accumulators are set up from the first
+  if (keys_.empty()) hasAccumulators_=accumulators_.InitializeFrom(file.get());
+  if (hasAccumulators_ && !accumulators_.Read(file.get()))
+  {
+    std::cerr << "Could not read the maps and sketches from " << outputFile << std::endl;
+    return false;
+  }
+  TDirectory *histogramDirectory=file->GetDirectory("Histograms");
+  if (histogramDirectory)
+  {
+    TIter next(histogramDirectory->GetListOfKeys());
+    while (TKey *histogramKey=(TKey*)next())
+    {
+      TH1 *histogram=nullptr;
+      histogramDirectory->GetObject(histogramKey->GetName(),histogram);
+      if (!histogram) continue;
+      std::map<std::string,TH1*>::iterator total=histograms_.find(histogram->GetName());
+      if (total==histograms_.end())
+      {
+        histogram->SetDirectory(nullptr);
+        histograms_[histogram->GetName()]=histogram;
+        continue;
+      }
+      // As hadd would: histograms that chose different ranges while warming up are rebinned to match
+      TList others;
+      others.Add(histogram);
+      total->second->Merge(&others);
+    }
+  }
+  // The file's entries go in a sub-list for its Validation tree, as the chain will have it
+  for (const std::string &name : ValidationMerger::GetEntryListNames())
+  {
+    TEntryList *entries=nullptr;
+    file->GetObject(name.c_str(),entries);
+    if (!entries) continue;
+    TEntryList fileEntries(name.c_str(),entries->GetTitle(),"Validation",outputFile.c_str());
+    for (Long64_t i=0;i<entries->GetN();++i) fileEntries.Enter(entries->GetEntry((int)i));
+    TEntryList *&total=entryLists_[name];
+    if (!total)
+    {
+      total=new TEntryList(name.c_str(),entries->GetTitle());
+      total->SetDirectory(nullptr);
+    }
+    total->Add(&fileEntries);
+  }
+  TIter next(file->GetListOfKeys());
+  while (TKey *treeKey=(TKey*)next())
+  {
+    if (std::string(treeKey->GetClassName())=="TTree" && !ACCUMULATOR_TREES.count(treeKey->GetName())) treeNames_.insert(treeKey->GetName());
+  }
+  keys_[key]=outputFile;
+  return true;
+}
+
+// The totals, as a module output has them
+bool ValidationAggregate::Write(TDirectory *directory) const
+{
+  directory->cd();
+  if (hasAccumulators_) accumulators_.Write(directory);
+  if (!histograms_.empty())
+  {
+    TDirectory *histogramDirectory=directory->mkdir("Histograms");
+    for (const std::pair<const std::string,TH1*> &histogram : histograms_) histogramDirectory->WriteTObject(histogram.second);
+  }
+  directory->cd();
+  for (const std::pair<const std::string,TEntryList*> &entries : entryLists_) directory->WriteTObject(entries.second);
+  return true;
+}
+
+bool ValidationAggregate::Save() const
+{
+  std::string partialName=fileName_+".partial.root";
+  {
+    TFile file(partialName.c_str(),"RECREATE");
+    if (file.IsZombie())
+    {
+      std::cerr << "Could not write " << partialName << std::endl;
+      return false;
+    }
+    std::string key, outputFile;
+    TTree *keyTree=new TTree("Keys","Cached outputs in the totals");
+    keyTree->SetDirectory(&file);
+    keyTree->Branch("key",&key);
+    keyTree->Branch("file",&outputFile);
+    for (const std::pair<const std::string,std::string> &added : keys_)
+    {
+      key=added.first;
+      outputFile=added.second;
+      keyTree->Fill();
+    }
+    std::string treeName;
+    TTree *treeNameTree=new TTree("Trees","Trees chained in the output");
+    treeNameTree->SetDirectory(&file);
+    treeNameTree->Branch("name",&treeName);
+    for (const std::string &name : treeNames_)
+    {
+      treeName=name;
+      treeNameTree->Fill();
+    }
+    file.Write();
+    Write(&file);
+    file.Close();
+  }
+  return (std::rename(partialName.c_str(),fileName_.c_str())==0);
+}
+
+// Each tree in the outputs, other than those of the accumulators, is chained across them
+bool ValidationAggregate::WriteOutput(const std::string &outputFile, const std::vector<std::string> &outputFiles) const
+{
+  TFile output(outputFile.c_str(),"RECREATE");
+  if (output.IsZombie())
+  {
+    std::cerr << "Could not write " << outputFile << std::endl;
+    return false;
+  }
+  std::vector<std::string> chainFiles;
+  std::set<std::string> seen; // Inputs with the same content share an output, which is counted once
+  for (const std::string &fileName : outputFiles)
+  {
+    std::string path=GetAbsolutePath(fileName);
+    if (seen.insert(path).second) chainFiles.push_back(path);
+  }
+  for (const std::string &name : treeNames_)
+  {
+    TChain chain(name.c_str());
+    for (const std::string &path : chainFiles) chain.Add(path.c_str());
+    output.WriteTObject(&chain,name.c_str());
+  }
+  bool ok=Write(&output);
+  output.Close();
+  std::cout << "Wrote the totals of " << keys_.size() << " cached outputs, and chains of their trees, to " << outputFile << std::endl;
+  return ok;
+}
+
+size_t ValidationAggregate::GetAddedCount() const
+{
+  return addedCount_;
+}
@@ -0,0 +1,49 @@
+#ifndef VALIDATIONAGGREGATE_HH
+#define VALIDATIONAGGREGATE_HH
+#include "TEntryList.h"
+#include "TH1.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "ValidationAccumulators.h"
+
+// The running totals of the per-file outputs in a ValidationCache: their maps, sketches and run and
+// time summaries, their histograms, and their entry lists, along with the keys of the outputs that
+// have been added. It is kept in the cache, so a rerun only reads the outputs that are new since the
+// last one. The accumulators can't take an output back out, so if one that was added is no longer
+// wanted (its input changed or went away) the totals are started again from the cached outputs.
+// The output it writes has the totals, and a Validation chain of the per-file trees, which stay in
+// the cache: the entry lists have a sub-list for each file, as TChain::SetEntryList expects
+class ValidationAggregate{
+public:
+  explicit ValidationAggregate(const std::string &fileName);
+  ~ValidationAggregate();
+  // Read the totals saved by an earlier run, if there are any. Returns false if they can't be read
+  bool Open();
+  // Bring the totals up to date with exactly these outputs. outputFiles[i] is the cached output for keys[i]
+  bool Update(const std::vector<std::string> &keys, const std::vector<std::string> &outputFiles);
+  // Replace the saved totals, in one go, so an interrupted job leaves the last ones
+  bool Save() const;
+  // Write the totals and a Validation chain of the outputs, in the order given
+  bool WriteOutput(const std::string &outputFile, const std::vector<std::string> &outputFiles) const;
+  size_t GetAddedCount() const; // Outputs read by the last Update
+
+private:
+  std::string fileName_;
+  std::map<std::string,std::string> keys_; // Key and output file of everything in the totals
+  std::set<std::string> treeNames_; // Trees in the outputs, to chain
+  bool hasAccumulators_;
+  ValidationAccumulators accumulators_;
+  std::map<std::string,TH1*> histograms_; // By name, from the Histograms directory
+  std::map<std::string,TEntryList*> entryLists_; // By name, with a sub-list per output file
+  size_t addedCount_;
+
+  void Clear();
+  bool Add(const std::string &key, const std::string &outputFile);
+  bool Write(TDirectory *directory) const;
+};
+
+#endif // VALIDATIONAGGREGATE_HH
@@ -0,0 +1,165 @@
+#include "ValidationCache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include <sys/stat.h>
+
+// Set by CMake from git describe, so that outputs made by other code aren't reused
+#ifndef VALIDATION_BUILD_ID
+#define VALIDATION_BUILD_ID "unknown"
+#endif
+
+namespace {
+  // Bump this when the output format changes, so that old outputs aren't reused
+  const char *CACHE_VERSION="ValidationCache 1";
+  const char *BUILD_ID=VALIDATION_BUILD_ID;
+
+  bool GetFileStatus(const std::string &fileName, long long &size, long long &modified)
+  {
+    struct stat status;
+    if (stat(fileName.c_str(),&status)!=0) return false;
+    size=(long long)status.st_size;
+    modified=(long long)status.st_mtime;
+    return true;
+  }
+}
+
+ValidationCache::ValidationCache(const std::string &directory, const std::string &configText) : directory_(directory)
+{
+  configHash_=Hash(CACHE_VERSION,std::string(CACHE_VERSION).size());
+  configHash_=Hash(BUILD_ID,std::string(BUILD_ID).size(),configHash_);
+  configHash_=Hash(configText.data(),configText.size(),configHash_);
+}
+
+std::string ValidationCache::GetIndexFileName() const
+{
+  return directory_+"/input_hashes.txt";
+}
+
+// Each line of the index is the hash, size and modification time of an input file, then its name
+bool ValidationCache::Open()
+{
+  struct stat status;
+  if (stat(directory_.c_str(),&status)!=0 || !S_ISDIR(status.st_mode))
+  {
+    std::cerr << "Cache directory " << directory_ << " doesn't exist" << std::endl;
+    return false;
+  }
+  inputHashes_.clear();
+  std::ifstream input(GetIndexFileName().c_str());
+  std::string line;
+  while (std::getline(input,line))
+  {
+    std::istringstream lineStream(line);
+    std::string hash, fileName;
+    InputHash inputHash;
+    if (!(lineStream >> hash >> inputHash.size_ >> inputHash.modified_)) continue;
+    std::getline(lineStream >> std::ws,fileName);
+    if (fileName.empty()) continue;
+    inputHash.hash_=std::stoull(hash,nullptr,16);
+    inputHashes_[fileName]=inputHash;
+  }
+  return true;
+}
+
+bool ValidationCache::Save() const
+{
+  std::string partialName=GetIndexFileName()+".tmp";
+  {
+    std::ofstream output(partialName.c_str());
+    for (const std::pair<const std::string,InputHash> &entry : inputHashes_)
+    {
+      output << ToHex(entry.second.hash_) << " " << entry.second.size_ << " " << entry.second.modified_ << " " << entry.first << std::endl;
+    }
+    if (!output)
+    {
+      std::cerr << "Could not write " << partialName << std::endl;
+      return false;
+    }
+  }
+  return (std::rename(partialName.c_str(),GetIndexFileName().c_str())==0);
+}
+
+std::string ValidationCache::GetKey(const std::string &inputFile)
+{
+  long long size, modified;
+  if (!GetFileStatus(inputFile,size,modified))
+  {
+    std::cerr << "Could not find " << inputFile << std::endl;
+    return "";
+  }
+  InputHash &inputHash=inputHashes_[inputFile];
+  if (inputHash.size_!=size || inputHash.modified_!=modified)
+  {
+    if (!HashFile(inputFile,inputHash.hash_))
+    {
+      std::cerr << "Could not read " << inputFile << std::endl;
+      inputHashes_.erase(inputFile);
+      return "";
+    }
+    inputHash.size_=size;
+    inputHash.modified_=modified;
+  }
+  return ToHex(inputHash.hash_)+"-"+ToHex(configHash_);
+}
+
+bool ValidationCache::HasOutput(const std::string &key) const
+{
+  long long size, modified;
+  return GetFileStatus(GetOutputFileName(key),size,modified);
+}
+
+std::string ValidationCache::GetOutputFileName(const std::string &key) const
+{
+  return directory_+"/Validation_"+key+".root";
+}
+
+std::string ValidationCache::GetPartialFileName(const std::string &key) const
+{
+  return directory_+"/Validation_"+key+".partial.root";
+}
+
+bool ValidationCache::Commit(const std::string &key) const
+{
+  return (std::rename(GetPartialFileName(key).c_str(),GetOutputFileName(key).c_str())==0);
+}
+
+std::string ValidationCache::GetAggregateFileName() const
+{
+  return directory_+"/Aggregate_"+ToHex(configHash_)+".root";
+}
+
+uint64_t ValidationCache::Hash(const char *data, size_t size, uint64_t hash)
+{
+  for (size_t i=0;i<size;++i)
+  {
+    hash^=(unsigned char)data[i];
+    hash*=1099511628211ULL;
+  }
+  return hash;
+}
+
+std::string ValidationCache::ToHex(uint64_t value)
+{
+  char text[17];
+  std::snprintf(text,sizeof(text),"%016llx",(unsigned long long)value);
+  return text;
+}
+
+bool ValidationCache::HashFile(const std::string &fileName, uint64_t &hash)
+{
+  std::ifstream input(fileName.c_str(),std::ios::binary);
+  if (!input) return false;
+  std::vector<char> buffer(1<<20);
+  hash=Hash(nullptr,0);
+  while (input)
+  {
+    input.read(buffer.data(),buffer.size());
+    hash=Hash(buffer.data(),(size_t)input.gcount(),hash);
+  }
+  return input.eof();
+}
@@ -0,0 +1,50 @@
+#ifndef VALIDATIONCACHE_HH
+#define VALIDATIONCACHE_HH
+#include <cstdint>
+#include <map>
+#include <string>
+
+// A directory of per-input-file outputs, so that reruns over a growing archive only process the new
+// or changed files, and then only add those to the running totals (see ValidationAggregate). Each output is named after a
+// key made from a hash of the input file's content and a hash of the module configuration and the
+// build of the code, so a changed file, configuration or build just makes a new key.
+// Hashing a file means reading all of it, so the content hashes are remembered in an index in the
+// directory, with each file's size and modification time: a file is only hashed again if they change
+class ValidationCache{
+public:
+  // configText is anything that affects the output, like the module's properties
+  ValidationCache(const std::string &directory, const std::string &configText);
+  // Read the index of content hashes. Returns false if the directory isn't there
+  bool Open();
+  // Write the index back, with any new hashes
+  bool Save() const;
+  // The key for an input file, or an empty string if it can't be read
+  std::string GetKey(const std::string &inputFile);
+  bool HasOutput(const std::string &key) const;
+  std::string GetOutputFileName(const std::string &key) const;
+  // Write a new output here, then Commit it, so that an interrupted job doesn't leave half an output in the cache
+  std::string GetPartialFileName(const std::string &key) const;
+  bool Commit(const std::string &key) const;
+  // The running totals of the outputs for this configuration
+  std::string GetAggregateFileName() const;
+
+  // 64-bit FNV-1a, carrying on from hash
+  static uint64_t Hash(const char *data, size_t size, uint64_t hash=14695981039346656037ULL);
+  static std::string ToHex(uint64_t value);
+  // The hash of a file's content
+  static bool HashFile(const std::string &fileName, uint64_t &hash);
+
+private:
+  struct InputHash{
+    long long size_=-1;
+    long long modified_=-1;
+    uint64_t hash_=0;
+  };
+  std::string directory_;
+  uint64_t configHash_;
+  std::map<std::string,InputHash> inputHashes_; // By input file name
+
+  std::string GetIndexFileName() const;
+};
+
+#endif // VALIDATIONCACHE_HH
@@ -0,0 +1,208 @@
+#include "ValidationDriver.h"
+
+// - Bayeux
+#include "bayeux/dpp/input_module.h"
+
+#include <exception>
+#include <iostream>
+#include <thread>
+
+#include "OrderedParticleTable.h"
+#include "TrackBatch.h"
+
+ValidationDriver::ValidationDriver(ValidationModule &module, int workerCount, int eventsInFlight)
+  : module_(module)
+{
+  workerCount_=(workerCount>0 ? workerCount : 1);
+  // Enough events for every worker to have one to build while the others wait to be recorded
+  eventsInFlight_=(size_t)(eventsInFlight>0 ? eventsInFlight : 4 * workerCount_);
+  if (eventsInFlight_<workerCount_) eventsInFlight_=workerCount_;
+}
+
+ValidationDriver::~ValidationDriver()
+{
+}
+
+bool ValidationDriver::WasStopped() const
+{
+  return stopped_;
+}
+
+Long64_t ValidationDriver::GetErrorCount() const
+{
+  return errorCount_;
+}
+
+Long64_t ValidationDriver::Run(const std::vector<std::string> &inputFiles, Long64_t maxEvents)
+{
+  jobs_.clear();
+  built_.clear();
+  events_.clear();
+  freeEvents_.clear();
+  eventsRead_=0;
+  readingDone_=false;
+  stopping_=false;
+  stopped_=false;
+  errorCount_=0;
+
+  for (size_t i=0;i<eventsInFlight_;i++)
+  {
+    events_.emplace_back(new ValidationEventStorage());
+    module_.InitializeEventStorage(*events_.back());
+    freeEvents_.push_back(events_.back().get());
+  }
+
+  // A shard has nothing to do after its range, so stop reading there
+  Long64_t endEvent=module_.GetEndEvent();
+  if (endEvent>=0 && (maxEvents<=0 || endEvent<maxEvents)) maxEvents=endEvent;
+  std::thread reader(&ValidationDriver::Read, this, inputFiles, maxEvents, module_.GetSkipEvents());
+  std::vector<std::thread> workers;
+  for (size_t i=0;i<workerCount_;i++) workers.emplace_back(&ValidationDriver::Work, this);
+
+  // Record the events in input order, as flreconstruct would have processed them
+  for (Long64_t sequence=0;;sequence++)
+  {
+    BuiltEvent built;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      eventBuilt_.wait(lock, [&]{ return built_.count(sequence) || (readingDone_ && sequence>=eventsRead_) || stopping_; });
+      if (!built_.count(sequence)) break;
+      built=built_[sequence];
+      built_.erase(sequence);
+    }
+    // Counts the event, checkpoints, and skips it if it is already in the output
+    dpp::base_module::process_status status=built.status_;
+    if (module_.StartEvent() && built.event_ && status==dpp::base_module::PROCESS_OK)
+    {
+      try
+      {
+        status=module_.RecordEvent(*built.event_);
+      }
+      catch (std::exception &e)
+      {
+        std::cerr<<"ValidationDriver: event "<<sequence<<": "<<e.what()<<std::endl;
+        status=dpp::base_module::PROCESS_FATAL;
+      }
+    }
+    if (status!=dpp::base_module::PROCESS_OK) ++errorCount_;
+    if (built.event_)
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      freeEvents_.push_back(built.event_);
+      eventFree_.notify_one();
+    }
+    if (status & dpp::base_module::PROCESS_FATAL)
+    {
+      Stop();
+      break;
+    }
+  }
+
+  reader.join();
+  for (std::thread &worker : workers) worker.join();
+  jobs_.clear();
+  built_.clear();
+  freeEvents_.clear();
+  events_.clear();
+  return eventsRead_;
+}
+
+void ValidationDriver::Stop()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  stopping_=true;
+  stopped_=true;
+  jobReady_.notify_all();
+  eventBuilt_.notify_all();
+  eventFree_.notify_all();
+}
+
+// Reader thread: read the records one file after the other and queue them for the workers
+void ValidationDriver::Read(const std::vector<std::string> &inputFiles, Long64_t maxEvents, Long64_t skipEvents)
+{
+  try
+  {
+    for (const std::string &inputFile : inputFiles)
+    {
+      dpp::input_module input;
+      input.set_single_input_file(inputFile);
+      input.initialize_simple();
+      while (!input.is_terminated())
+      {
+        if (maxEvents>0 && eventsRead_>=maxEvents) break;
+        std::unique_ptr<datatools::things> record(new datatools::things());
+        if (input.process(*record)!=dpp::base_module::PROCESS_OK) break;
+        std::unique_lock<std::mutex> lock(mutex_);
+        Long64_t sequence=eventsRead_;
+        if (sequence<skipEvents)
+        {
+          // Before the shard's range, or already in the output from before the checkpoint: no need to build it
+          built_[sequence]=BuiltEvent();
+        }
+        else
+        {
+          eventFree_.wait(lock, [&]{ return !freeEvents_.empty() || stopping_; });
+          if (stopping_) break;
+          Job job;
+          job.sequence_=sequence;
+          job.record_=std::move(record);
+          job.event_=freeEvents_.back();
+          freeEvents_.pop_back();
+          jobs_.push_back(std::move(job));
+          jobReady_.notify_one();
+        }
+        ++eventsRead_;
+        eventBuilt_.notify_all();
+      }
+      input.reset();
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) break;
+      }
+      if (maxEvents>0 && eventsRead_>=maxEvents) break;
+    }
+  }
+  catch (std::exception &e)
+  {
+    std::cerr<<"ValidationDriver: could not read the input: "<<e.what()<<std::endl;
+    Stop();
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  readingDone_=true;
+  jobReady_.notify_all();
+  eventBuilt_.notify_all();
+}
+
+// Worker thread: build events from the queued records, in whatever order they come
+void ValidationDriver::Work()
+{
+  // Reused for every event this worker builds
+  OrderedParticleTable electronTable;
+  TrackBatch trackBatch;
+  while (true)
+  {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      jobReady_.wait(lock, [&]{ return !jobs_.empty() || readingDone_ || stopping_; });
+      if (jobs_.empty()) return;
+      job=std::move(jobs_.front());
+      jobs_.pop_front();
+    }
+    BuiltEvent built;
+    built.event_=job.event_;
+    try
+    {
+      built.status_=module_.BuildEvent(*job.record_, *job.event_, electronTable, trackBatch);
+    }
+    catch (std::exception &e)
+    {
+      std::cerr<<"ValidationDriver: event "<<job.sequence_<<": "<<e.what()<<std::endl;
+      built.status_=dpp::base_module::PROCESS_FATAL;
+    }
+    job.record_.reset();
+    std::lock_guard<std::mutex> lock(mutex_);
+    built_[job.sequence_]=built;
+    eventBuilt_.notify_all();
+  }
+}
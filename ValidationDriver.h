@@ -0,0 +1,72 @@
+#ifndef VALIDATIONDRIVER_HH
+#define VALIDATIONDRIVER_HH
+#include "Rtypes.h"
+
+// - Bayeux
+#include "bayeux/datatools/things.h"
+#include "bayeux/dpp/base_module.h"
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ValidationModule.h"
+#include "ValidationEventStorage.h"
+
+// Runs an initialized ValidationModule over brio files on several threads, instead of one
+// record at a time inside flreconstruct. One thread reads the records, the workers build the
+// events from them (BuildEvent), and the thread that calls Run records them (RecordEvent) in
+// input order, so the output is the same as flreconstruct's. Each worker has its own electron
+// table. The accumulators are filled as each event is recorded, so that they only ever have the
+// events that are in the tree, even if the module stops the run
+class ValidationDriver{
+public:
+  // eventsInFlight is how many events can be read but not yet recorded; it bounds the memory
+  ValidationDriver(ValidationModule &module, int workerCount, int eventsInFlight);
+  ~ValidationDriver();
+  // Process the files one after the other, at most maxEvents events if more than 0.
+  // Returns the number of input events read. Reset the module afterwards to write the output
+  Long64_t Run(const std::vector<std::string> &inputFiles, Long64_t maxEvents);
+  // True if the module returned PROCESS_FATAL and the run was stopped early
+  bool WasStopped() const;
+  Long64_t GetErrorCount() const; // Events the module didn't return PROCESS_OK for
+
+private:
+  struct Job{
+    Long64_t sequence_=0;
+    std::unique_ptr<datatools::things> record_;
+    ValidationEventStorage *event_=nullptr;
+  };
+  struct BuiltEvent{
+    dpp::base_module::process_status status_=dpp::base_module::PROCESS_OK;
+    ValidationEventStorage *event_=nullptr; // Null for an event skipped without building
+  };
+
+  ValidationModule &module_;
+  size_t workerCount_;
+  size_t eventsInFlight_;
+
+  std::mutex mutex_; // Guards everything below
+  std::condition_variable jobReady_; // Workers wait for a job
+  std::condition_variable eventBuilt_; // The recorder waits for the next event in order
+  std::condition_variable eventFree_; // The reader waits for a free event storage
+  std::deque<Job> jobs_;
+  std::map<Long64_t, BuiltEvent> built_; // Built events waiting to be recorded, by input sequence
+  std::vector<std::unique_ptr<ValidationEventStorage>> events_; // The pool, one for each event in flight
+  std::vector<ValidationEventStorage*> freeEvents_;
+  Long64_t eventsRead_=0;
+  bool readingDone_=false;
+  bool stopping_=false;
+  bool stopped_=false;
+  Long64_t errorCount_=0;
+
+  void Read(const std::vector<std::string> &inputFiles, Long64_t maxEvents, Long64_t skipEvents);
+  void Work();
+  void Stop();
+};
+
+#endif // VALIDATIONDRIVER_HH
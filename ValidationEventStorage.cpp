@@ -0,0 +1,119 @@
+#include "ValidationEventStorage.h"
+
+#include <utility>
+
+const std::vector<ScalarQuantity>& GetScalarQuantities()
+{
+  typedef ValidationEventStorage S;
+  static const std::vector<ScalarQuantity> quantities={
+    // Some basic counts
+    {"h_calorimeter_hit_count",nullptr,&S::h_calorimeter_hit_count_},
+    {"h_calo_hits_over_threshold",nullptr,&S::h_calo_hits_over_threshold_},
+    {"h_cluster_count",nullptr,&S::h_cluster_count_},
+    {"h_track_count",nullptr,&S::h_track_count_},
+    {"h_negative_track_count",nullptr,&S::h_negative_track_count_},
+    {"h_positive_track_count",nullptr,&S::h_positive_track_count_},
+    {"h_associated_track_count",nullptr,&S::h_associated_track_count_},
+    {"h_geiger_hit_count",nullptr,&S::h_geiger_hit_count_},
+    // Energies and calo times
+    {"h_total_calorimeter_energy",&S::h_total_calorimeter_energy_,nullptr},
+    {"h_calo_energy_over_threshold",&S::h_calo_energy_over_threshold_,nullptr},
+    {"h_unassociated_calorimeter_energy",&S::h_unassociated_calorimeter_energy_,nullptr},
+    {"h_associated_calorimeter_energy",&S::h_associated_calorimeter_energy_,nullptr},
+    {"h_unassociated_energy_over_threshold",&S::h_unassociated_energy_over_threshold_,nullptr},
+    {"h_associated_energy_over_threshold",&S::h_associated_energy_over_threshold_,nullptr},
+    {"h_calo_hit_time_separation",&S::h_calo_hit_time_separation_,nullptr}
+  };
+  return quantities;
+}
+
+void SwapEventStorage(ValidationEventStorage &a, ValidationEventStorage &b)
+{
+  // Swapping the whole structs swaps every vector's contents in place, apart from the band
+  // maps, whose inner vectors would move with their outer buffers. So put the outer buffers
+  // back and swap the bands individually
+  std::swap(a,b);
+  a.c_calorimeter_hit_map_bands_.swap(b.c_calorimeter_hit_map_bands_);
+  a.c_calorimeter_hit_map_bands_str_.swap(b.c_calorimeter_hit_map_bands_str_);
+  for (size_t band=0;band<a.c_calorimeter_hit_map_bands_.size();++band)
+    a.c_calorimeter_hit_map_bands_[band].swap(b.c_calorimeter_hit_map_bands_[band]);
+  for (size_t band=0;band<a.c_calorimeter_hit_map_bands_str_.size();++band)
+    a.c_calorimeter_hit_map_bands_str_[band].swap(b.c_calorimeter_hit_map_bands_str_[band]);
+}
+
+namespace {
+  template<typename T> size_t VectorBytes(const std::vector<T> &values)
+  {
+    return values.capacity()*sizeof(T);
+  }
+
+  size_t VectorBytes(const std::vector<std::string> &values)
+  {
+    size_t bytes=values.capacity()*sizeof(std::string);
+    for (size_t i=0;i<values.size();++i)
+    {
+      if (values[i].capacity()>=sizeof(std::string)) bytes+=values[i].capacity(); // Longer than the short string buffer
+    }
+    return bytes;
+  }
+
+  template<typename T> void Shrink(std::vector<T> &values)
+  {
+    values.shrink_to_fit();
+  }
+}
+
+size_t GetEventStorageBytes(const ValidationEventStorage &event)
+{
+  size_t bytes=sizeof(ValidationEventStorage);
+  bytes+=VectorBytes(event.v_all_track_hit_counts_);
+  bytes+=VectorBytes(event.t_cell_hit_count_);
+  bytes+=VectorBytes(event.tm_average_drift_radius_);
+  bytes+=VectorBytes(event.t_track_cell_hit_map_);
+  bytes+=VectorBytes(event.tm_track_drift_radius_);
+  bytes+=VectorBytes(event.tm_trajectory_distance_);
+  bytes+=VectorBytes(event.tm_drift_radius_residual_);
+  bytes+=VectorBytes(event.v_track_cell_x_);
+  bytes+=VectorBytes(event.v_track_cell_y_);
+  bytes+=VectorBytes(event.c_calorimeter_hit_map_);
+  bytes+=VectorBytes(event.c_calorimeter_hit_map_backscatter_);
+  bytes+=VectorBytes(event.cm_average_calorimeter_energy_);
+  bytes+=VectorBytes(event.electron_vertex_x_);
+  bytes+=VectorBytes(event.electron_vertex_y_);
+  bytes+=VectorBytes(event.electron_vertex_z_);
+  bytes+=VectorBytes(event.track_calo_hits_);
+  bytes+=VectorBytes(event.c_calorimeter_hit_map_str_);
+  bytes+=VectorBytes(event.c_calorimeter_hit_map_backscatter_str_);
+  bytes+=VectorBytes(event.track_calo_hits_str_);
+  for (size_t band=0;band<event.c_calorimeter_hit_map_bands_.size();++band)
+    bytes+=sizeof(std::vector<int>)+VectorBytes(event.c_calorimeter_hit_map_bands_[band]);
+  for (size_t band=0;band<event.c_calorimeter_hit_map_bands_str_.size();++band)
+    bytes+=sizeof(std::vector<std::string>)+VectorBytes(event.c_calorimeter_hit_map_bands_str_[band]);
+  return bytes;
+}
+
+void ShrinkEventStorage(ValidationEventStorage &event)
+{
+  Shrink(event.v_all_track_hit_counts_);
+  Shrink(event.t_cell_hit_count_);
+  Shrink(event.tm_average_drift_radius_);
+  Shrink(event.t_track_cell_hit_map_);
+  Shrink(event.tm_track_drift_radius_);
+  Shrink(event.tm_trajectory_distance_);
+  Shrink(event.tm_drift_radius_residual_);
+  Shrink(event.v_track_cell_x_);
+  Shrink(event.v_track_cell_y_);
+  Shrink(event.c_calorimeter_hit_map_);
+  Shrink(event.c_calorimeter_hit_map_backscatter_);
+  Shrink(event.cm_average_calorimeter_energy_);
+  Shrink(event.electron_vertex_x_);
+  Shrink(event.electron_vertex_y_);
+  Shrink(event.electron_vertex_z_);
+  Shrink(event.track_calo_hits_);
+  Shrink(event.c_calorimeter_hit_map_str_);
+  Shrink(event.c_calorimeter_hit_map_backscatter_str_);
+  Shrink(event.track_calo_hits_str_);
+  // Only the inner band vectors: the outer ones must stay where they are
+  for (size_t band=0;band<event.c_calorimeter_hit_map_bands_.size();++band) Shrink(event.c_calorimeter_hit_map_bands_[band]);
+  for (size_t band=0;band<event.c_calorimeter_hit_map_bands_str_.size();++band) Shrink(event.c_calorimeter_hit_map_bands_str_[band]);
+}
@@ -0,0 +1,109 @@
+//! \file    ValidationEventStorage.h
+//! \brief   Variables written to the Validation tree for each event
+#ifndef VALIDATIONEVENTSTORAGE_HH
+#define VALIDATIONEVENTSTORAGE_HH
+
+#include <string>
+#include <vector>
+
+typedef struct ValidationEventStorage{
+  // Quantities to histogram (h_)
+  double h_total_calorimeter_energy_;
+  double h_calo_energy_over_threshold_; // 50keV threshold to remove noise
+  double h_calo_hit_time_separation_; // Between the first and last calo hits
+  int h_calorimeter_hit_count_; // How many calorimeter hits?
+  int h_calo_hits_over_threshold_; // How many calorimeter hits over threshold?
+  int h_cluster_count_; // How many clusters with 3 or more hits?
+  int h_track_count_; // How many reconstructed tracks?
+  int h_negative_track_count_; // How many reconstructed tracks with negative curvature?
+  int h_positive_track_count_; // How many reconstructed tracks with positive curvature?
+  int h_associated_track_count_; // How many reconstructed tracks with an associated calorimeter?
+  int h_geiger_hit_count_; // How many reconstructed tracker hits?
+  double h_unassociated_calorimeter_energy_; // Summed calorimeter energy not associated to any track (in MeV)
+  double h_unassociated_energy_over_threshold_; // Threshold is 50 keV
+  double h_associated_calorimeter_energy_; // Summed calorimeter energy associated to any track (in MeV)
+  double h_associated_energy_over_threshold_; // Threshold is 50 keV
+
+
+  // For vector (v_) quantities you can have more than 1 entry per event
+  // NOT implemented yet!
+  std::vector<int> v_all_track_hit_counts_; // Vector of how many hits for ALL tracks (delayed or not)
+
+  // For tracker maps: some values want to be summed over all events (t_), and some to be averaged (tm_)
+  // All tm variables will need to be paired with a hit map, so that we can match the vector of values
+  // to a vector of locations. This pairing must be defined in the config file.
+
+  std::vector<int> t_cell_hit_count_; // map of cells that have been hit
+  std::vector<double> tm_average_drift_radius_; // map of cells that have been hit
+  // Hits on fitted tracks: cell location, drift radius, distance from the wire to the trajectory,
+  // and the residual (distance minus drift radius), all in the same order
+  std::vector<int> t_track_cell_hit_map_;
+  std::vector<double> tm_track_drift_radius_;
+  std::vector<double> tm_trajectory_distance_;
+  std::vector<double> tm_drift_radius_residual_;
+  std::vector<double> v_track_cell_x_; // Wire positions of the same hits
+  std::vector<double> v_track_cell_y_;
+  // For calorimeter maps : some values want to be summed over all events (c_), and some to be averaged (cm_)
+  // All cm variables will need to be paired with a hit map, so that we can match the vector of values
+  // to a vector of locations. This pairing must be defined in the config file.
+  // Locations are encoded as integers, see CaloLocation.h
+  std::vector<int> c_calorimeter_hit_map_;
+
+  // One calorimeter map for each energy band. These are sized in initialize() and must not be resized after that
+  std::vector<std::vector<int> > c_calorimeter_hit_map_bands_;
+  std::vector<int> c_calorimeter_hit_map_backscatter_;
+  //
+
+  std::vector<double> cm_average_calorimeter_energy_;
+
+//changes
+std::vector<double> electron_vertex_x_;
+std::vector<double> electron_vertex_y_;
+std::vector<double> electron_vertex_z_;
+std::vector<int> track_calo_hits_;
+
+  // Only filled with calo_string_ids: the same calorimeter locations as geomID strings, as they used to be written
+  std::vector<std::string> c_calorimeter_hit_map_str_;
+  std::vector<std::vector<std::string> > c_calorimeter_hit_map_bands_str_;
+  std::vector<std::string> c_calorimeter_hit_map_backscatter_str_;
+  std::vector<std::string> track_calo_hits_str_;
+
+  // With detail_sample_fraction: does this event have its per-hit and per-electron branches filled?
+  bool detail_sampled_;
+
+  // The event's topology bit and flags, from EventTopology.h
+  unsigned int event_topology_;
+
+  // From the event header, or -1 if there isn't one. Not branches: they are for the output file
+  // index and the run and time summaries
+  int run_number_;
+  long long timestamp_; // Seconds
+
+}Validationeventstorage;
+
+// One of the per-event h_ quantities, with a pointer to its member of ValidationEventStorage,
+// so that code that handles all of them doesn't need its own list
+struct ScalarQuantity{
+  const char* name_; // Branch name
+  double ValidationEventStorage::* doubleMember_; // One of these two is null
+  int ValidationEventStorage::* intMember_;
+
+  double GetValue(const ValidationEventStorage &storage) const
+  {
+    return (doubleMember_ ? storage.*doubleMember_ : storage.*intMember_);
+  }
+};
+
+// All the h_ quantities, in the order their branches are booked
+const std::vector<ScalarQuantity>& GetScalarQuantities();
+
+// Swap the contents of two events, without moving any of the vectors that branches point at:
+// the band maps are swapped one by one, so both events must have the same number of bands
+void SwapEventStorage(ValidationEventStorage &a, ValidationEventStorage &b);
+// Memory held by the event's vectors, counting their capacity rather than their size
+size_t GetEventStorageBytes(const ValidationEventStorage &event);
+// Give back the memory the vectors kept from their largest event. Like swapping, this doesn't
+// move any of the vectors that branches point at
+void ShrinkEventStorage(ValidationEventStorage &event);
+
+#endif // VALIDATIONEVENTSTORAGE_HH
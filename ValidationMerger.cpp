@@ -0,0 +1,291 @@
+#include "ValidationMerger.h"
+#include "TChain.h"
+#include "TEntryList.h"
+#include "TFile.h"
+#include "TFileMerger.h"
+#include "TTree.h"
+
+#include "EventTopology.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+ValidationMerger::ValidationMerger(int threadCount)
+{
+  threadCount_=(threadCount>0 ? threadCount : 1);
+}
+
+bool ValidationMerger::Merge(const std::vector<std::string> &inputFiles, const std::string &outputFile)
+{
+  if (inputFiles.empty())
+  {
+    std::cerr << "No files to merge" << std::endl;
+    return false;
+  }
+  std::vector<ShardFile> shards(inputFiles.size());
+  for (size_t i=0;i<inputFiles.size();++i)
+  {
+    if (!ReadShard(inputFiles[i],shards[i])) return false;
+  }
+  if (!OrderShards(shards)) return false;
+  int compression=0; // Keep the inputs' compression, so the tree baskets can be copied as they are
+  {
+    std::unique_ptr<TFile> first(TFile::Open(shards.front().fileName_.c_str(),"READ"));
+    if (first) compression=first->GetCompressionSettings();
+  }
+
+  // Merge each group of shards on its own thread, then merge the groups
+  std::vector<std::vector<std::string>> groups=GroupShards(shards);
+  bool ok=true;
+  if (groups.size()==1) ok=MergeFiles(groups.front(),outputFile,compression);
+  else
+  {
+    std::vector<std::string> partFiles;
+    std::vector<char> groupOk(groups.size(),0);
+    std::vector<std::thread> threads;
+    for (size_t group=0;group<groups.size();++group)
+    {
+      partFiles.push_back(outputFile+".part"+std::to_string(group));
+      threads.emplace_back([&,group]{ groupOk[group]=MergeFiles(groups[group],partFiles[group],compression); });
+    }
+    for (std::thread &thread : threads) thread.join();
+    for (size_t group=0;group<groups.size();++group) ok=ok && groupOk[group];
+    if (ok) ok=MergeFiles(partFiles,outputFile,compression);
+    for (const std::string &partFile : partFiles) std::remove(partFile.c_str());
+  }
+  if (!ok)
+  {
+    std::cerr << "Could not merge the shards into " << outputFile << std::endl;
+    return false;
+  }
+
+  ValidationAccumulators accumulators;
+  if (!MergeAccumulators(groups,accumulators)) return false;
+  TFile output(outputFile.c_str(),"UPDATE");
+  if (output.IsZombie())
+  {
+    std::cerr << "Could not reopen " << outputFile << std::endl;
+    return false;
+  }
+  accumulators.Write(&output);
+  ok=MergeEntryLists(shards,&output) && MergeDetail(shards,&output);
+  output.Close();
+  Long64_t entries=0;
+  for (const ShardFile &shard : shards) entries+=shard.entries_;
+  std::cout << "Merged " << shards.size() << " files with " << entries << " Validation entries into " << outputFile << std::endl;
+  return ok;
+}
+
+// The input events and Validation entries in a file, from its Shard tree. A file that has already
+// been merged has an entry for each of its shards, which are in order
+bool ValidationMerger::ReadShard(const std::string &fileName, ShardFile &shard) const
+{
+  shard.fileName_=fileName;
+  std::unique_ptr<TFile> file(TFile::Open(fileName.c_str(),"READ"));
+  if (!file || file->IsZombie())
+  {
+    std::cerr << "Could not open " << fileName << std::endl;
+    return false;
+  }
+  TTree *shardTree=nullptr;
+  file->GetObject("Shard",shardTree);
+  if (shardTree && shardTree->GetEntries()>0)
+  {
+    Long64_t firstEvent, endEvent, entries;
+    shardTree->SetBranchAddress("first_event",&firstEvent);
+    shardTree->SetBranchAddress("end_event",&endEvent);
+    shardTree->SetBranchAddress("entries",&entries);
+    shard.hasShardInfo_=true;
+    shard.entries_=0;
+    for (Long64_t entry=0;entry<shardTree->GetEntries();++entry)
+    {
+      shardTree->GetEntry(entry);
+      if (entry==0) shard.firstEvent_=firstEvent;
+      shard.endEvent_=endEvent;
+      shard.entries_+=entries;
+    }
+    return true;
+  }
+  // Not a shard: merge it in the order given
+  TTree *tree=nullptr;
+  file->GetObject("Validation",tree);
+  shard.entries_=(tree ? tree->GetEntries() : 0);
+  return true;
+}
+
+// Sort the shards by their first input event, and check they don't overlap
+bool ValidationMerger::OrderShards(std::vector<ShardFile> &shards) const
+{
+  size_t withShardInfo=std::count_if(shards.begin(),shards.end(),[](const ShardFile &shard){ return shard.hasShardInfo_; });
+  if (withShardInfo==0)
+  {
+    std::cout << "None of the files has a Shard tree: merging them in the order given" << std::endl;
+    return true;
+  }
+  if (withShardInfo<shards.size())
+  {
+    std::cerr << "Only some of the files have a Shard tree, so they can't be put in order" << std::endl;
+    return false;
+  }
+  std::stable_sort(shards.begin(),shards.end(),[](const ShardFile &a, const ShardFile &b){ return a.firstEvent_<b.firstEvent_; });
+  for (size_t i=1;i<shards.size();++i)
+  {
+    const ShardFile &previous=shards[i-1];
+    if (shards[i].firstEvent_<previous.endEvent_)
+    {
+      std::cerr << shards[i].fileName_ << " (from input event " << shards[i].firstEvent_ << ") overlaps "
+                << previous.fileName_ << " (to input event " << previous.endEvent_-1 << ")" << std::endl;
+      return false;
+    }
+    if (shards[i].firstEvent_>previous.endEvent_)
+    {
+      std::cerr << "Input events " << previous.endEvent_ << " to " << shards[i].firstEvent_-1
+                << " aren't in any of the files" << std::endl;
+    }
+  }
+  return true;
+}
+
+// One group of consecutive shards per thread, as evenly as possible
+std::vector<std::vector<std::string>> ValidationMerger::GroupShards(const std::vector<ShardFile> &shards) const
+{
+  size_t groupCount=std::min(threadCount_,shards.size());
+  std::vector<std::vector<std::string>> groups(groupCount);
+  for (size_t i=0;i<shards.size();++i) groups[i*groupCount/shards.size()].push_back(shards[i].fileName_);
+  return groups;
+}
+
+// As hadd would, in the order given, leaving out what is merged separately and what only makes
+// sense for each shard on its own
+bool ValidationMerger::MergeFiles(const std::vector<std::string> &inputFiles, const std::string &outputFile, int compression)
+{
+  TFileMerger merger(false);
+  merger.SetFastMethod(true); // Copy the tree baskets without decompressing them
+  if (!merger.OutputFile(outputFile.c_str(),"RECREATE",compression)) return false;
+  for (const std::string &inputFile : inputFiles)
+  {
+    if (!merger.AddFile(inputFile.c_str(),false)) return false;
+  }
+  merger.AddObjectNames("Maps Sketches RunSummary TimeSummary ValidationDetail");
+  merger.AddObjectNames("FlaggedChannels ReferenceAlarms ReferenceComparison");
+  for (const std::string &name : GetEntryListNames()) merger.AddObjectNames(name.c_str());
+  return merger.PartialMerge(TFileMerger::kAll | TFileMerger::kRegular | TFileMerger::kSkipListed);
+}
+
+// Each group's accumulators are read on its own thread. Every shard was made with the same
+// settings, so they are taken from the first one
+bool ValidationMerger::MergeAccumulators(const std::vector<std::vector<std::string>> &groups,
+                                         ValidationAccumulators &accumulators) const
+{
+  {
+    std::unique_ptr<TFile> first(TFile::Open(groups.front().front().c_str(),"READ"));
+    if (!first || !accumulators.InitializeFrom(first.get())) return true; // No maps or sketches to merge
+  }
+  std::vector<ValidationAccumulators> groupAccumulators(groups.size(),accumulators);
+  std::vector<char> groupOk(groups.size(),0);
+  std::vector<std::thread> threads;
+  for (size_t group=0;group<groups.size();++group)
+  {
+    threads.emplace_back([&,group]{ groupOk[group]=ReadAccumulators(groups[group],groupAccumulators[group]); });
+  }
+  for (std::thread &thread : threads) thread.join();
+  for (size_t group=0;group<groups.size();++group)
+  {
+    if (!groupOk[group]) return false;
+    accumulators.Merge(groupAccumulators[group]);
+  }
+  return true;
+}
+
+bool ValidationMerger::ReadAccumulators(const std::vector<std::string> &inputFiles, ValidationAccumulators &accumulators)
+{
+  for (const std::string &inputFile : inputFiles)
+  {
+    std::unique_ptr<TFile> file(TFile::Open(inputFile.c_str(),"READ"));
+    if (!file || file->IsZombie() || !accumulators.Read(file.get()))
+    {
+      std::cerr << "Could not read the maps and sketches from " << inputFile << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<std::string> ValidationMerger::GetEntryListNames()
+{
+  std::vector<std::string> names={"detail_entries"};
+  for (int topology=0;topology<TOPOLOGY_COUNT;++topology) names.push_back(std::string("topology_")+TOPOLOGY_NAMES[topology]);
+  return names;
+}
+
+// Each shard numbers its entries from 0, so move its entry numbers along by the entries of the
+// shards before it. A list that none of the shards has isn't written
+bool ValidationMerger::MergeEntryLists(const std::vector<ShardFile> &shards, TDirectory *output)
+{
+  std::vector<std::string> names=GetEntryListNames();
+  std::vector<TEntryList*> mergedLists(names.size(),nullptr);
+  Long64_t offset=0;
+  for (const ShardFile &shard : shards)
+  {
+    std::unique_ptr<TFile> file(TFile::Open(shard.fileName_.c_str(),"READ"));
+    if (!file || file->IsZombie()) return false;
+    for (size_t list=0;list<names.size();++list)
+    {
+      TEntryList *entries=nullptr;
+      file->GetObject(names[list].c_str(),entries);
+      if (!entries) continue;
+      if (!mergedLists[list]) mergedLists[list]=new TEntryList(names[list].c_str(),entries->GetTitle(),"Validation",output->GetName());
+      for (Long64_t i=0;i<entries->GetN();++i) mergedLists[list]->Enter(entries->GetEntry((int)i)+offset);
+    }
+    offset+=shard.entries_;
+  }
+  output->cd();
+  for (TEntryList *merged : mergedLists)
+  {
+    if (!merged) continue;
+    output->WriteTObject(merged,nullptr,"Overwrite");
+    delete merged;
+  }
+  return true;
+}
+
+// The ValidationDetail tree, with the entry branch moved along as for the entry lists
+bool ValidationMerger::MergeDetail(const std::vector<ShardFile> &shards, TDirectory *output)
+{
+  TChain detailChain("ValidationDetail");
+  std::vector<Long64_t> detailOffsets; // For each file in the chain
+  Long64_t offset=0;
+  for (const ShardFile &shard : shards)
+  {
+    std::unique_ptr<TFile> file(TFile::Open(shard.fileName_.c_str(),"READ"));
+    if (!file || file->IsZombie()) return false;
+    TTree *detail=nullptr;
+    file->GetObject("ValidationDetail",detail);
+    if (detail)
+    {
+      detailChain.Add(shard.fileName_.c_str());
+      detailOffsets.push_back(offset);
+    }
+    offset+=shard.entries_;
+  }
+  output->cd();
+  if (!detailOffsets.empty())
+  {
+    Long64_t entry=0;
+    detailChain.SetBranchAddress("entry",&entry);
+    TTree *mergedDetail=detailChain.CloneTree(0);
+    mergedDetail->SetDirectory(output);
+    for (Long64_t i=0;i<detailChain.GetEntries();++i)
+    {
+      if (detailChain.GetEntry(i)<=0) continue;
+      entry+=detailOffsets.at(detailChain.GetTreeNumber());
+      mergedDetail->Fill();
+    }
+    output->WriteTObject(mergedDetail,nullptr,"Overwrite");
+    delete mergedDetail;
+  }
+  return true;
+}
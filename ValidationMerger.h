@@ -0,0 +1,50 @@
+#ifndef VALIDATIONMERGER_HH
+#define VALIDATIONMERGER_HH
+#include "Rtypes.h"
+
+#include <string>
+#include <vector>
+
+#include "ValidationAccumulators.h"
+
+// Merges the outputs of jobs that each did a shard (a range of input events) of the same input,
+// so that the result is the same as one job over all of it, apart from which events have details
+// (each shard samples its own, with its own seed). The shards are put in order of their
+// first input event, from the Shard tree the module writes, and must not overlap. Then:
+// - the Validation trees, histograms and anything else are merged as hadd would, in shard order;
+// - the maps, sketches and run and time summaries are added up with ValidationAccumulators,
+//   rather than concatenated;
+// - the detail_entries and topology_* entry lists and the ValidationDetail tree get their entry
+//   numbers moved along by the entries of the shards before them;
+// - the channel monitor and reference comparison trees are left out: they are for the windows
+//   and comparisons of each shard on its own, so they are only in the shards' files.
+// The first two are done for groups of shards on separate threads, and the groups then merged
+class ValidationMerger{
+public:
+  explicit ValidationMerger(int threadCount);
+  // Returns false (having said why) if the shards can't be merged
+  bool Merge(const std::vector<std::string> &inputFiles, const std::string &outputFile);
+  // The lists of Validation entries: the detail sample and each event topology
+  static std::vector<std::string> GetEntryListNames();
+
+private:
+  struct ShardFile{
+    std::string fileName_;
+    bool hasShardInfo_=false;
+    Long64_t firstEvent_=0;
+    Long64_t endEvent_=0;
+    Long64_t entries_=0; // Validation tree entries, for the offsets of the detail entry numbers
+  };
+  size_t threadCount_;
+
+  bool ReadShard(const std::string &fileName, ShardFile &shard) const;
+  bool OrderShards(std::vector<ShardFile> &shards) const;
+  std::vector<std::vector<std::string>> GroupShards(const std::vector<ShardFile> &shards) const;
+  static bool MergeFiles(const std::vector<std::string> &inputFiles, const std::string &outputFile, int compression);
+  bool MergeAccumulators(const std::vector<std::vector<std::string>> &groups, ValidationAccumulators &accumulators) const;
+  static bool ReadAccumulators(const std::vector<std::string> &inputFiles, ValidationAccumulators &accumulators);
+  static bool MergeEntryLists(const std::vector<ShardFile> &shards, TDirectory *output);
+  static bool MergeDetail(const std::vector<ShardFile> &shards, TDirectory *output);
+};
+
+#endif // VALIDATIONMERGER_HH
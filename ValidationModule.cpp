@@ -1,5 +1,11 @@
 #include "ValidationModule.h"
-const double LOW_ENERGY_LIMIT=0.050; // 50 keV
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
 
 int mainWallHitType=1302;
 int xWallHitType=1232;
@@ -8,10 +14,90 @@ int gammaVetoHitType=1252;
 using namespace std;
 
 
+namespace {
+  // How often to look at the module's memory
+  const Long64_t MEMORY_CHECK_EVENTS=100;
+
+  // Books a branch, or points an existing one at the same address
+  struct BranchBinder{
+    TTree *tree_;
+    bool existing_;
+    template<typename T> void operator()(const char *name, T *address) const
+    {
+      if (existing_) tree_->SetBranchAddress(name,address);
+      else tree_->Branch(name,address);
+    }
+  };
+
+  // A line of the output file index: file name, first entry, entries and run numbers
+  void WriteChunkLine(std::ostream &output, const OutputChunk &chunk)
+  {
+    output << chunk.fileName_ << " " << chunk.firstEntry_ << " " << chunk.entryCount_ << " ";
+    if (chunk.runs_.empty()) output << "-";
+    for (std::set<int>::const_iterator run=chunk.runs_.begin();run!=chunk.runs_.end();++run)
+    {
+      if (run!=chunk.runs_.begin()) output << ",";
+      output << *run;
+    }
+    output << std::endl;
+  }
+
+  bool ReadChunkLine(const std::string &line, OutputChunk &chunk)
+  {
+    std::istringstream input(line);
+    std::string runs;
+    if (!(input >> chunk.fileName_ >> chunk.firstEntry_ >> chunk.entryCount_ >> runs)) return false;
+    chunk.runs_.clear();
+    if (runs=="-") return true;
+    std::istringstream runInput(runs);
+    std::string run;
+    while (std::getline(runInput,run,',')) chunk.runs_.insert(std::atoi(run.c_str()));
+    return true;
+  }
+}
+
 DPP_MODULE_REGISTRATION_IMPLEMENT(ValidationModule,"ValidationModule");
 ValidationModule::ValidationModule() : dpp::base_module()
 {
   filename_output_="Validation.root";
+  caloStringIds_=false;
+  accumulateMaps_=false;
+  writeHitVectors_=true;
+  quantileSketches_=true;
+  sketchAccuracy_=0.01;
+  runSummary_=true;
+  timeBucketSeconds_=3600;
+  topologyEntryLists_=true;
+  monitorChannels_=false;
+  detailFraction_=1;
+  detailReservoirSize_=0;
+  detailSeed_=1;
+  detailEntries_=nullptr;
+  histogramOnly_=false;
+  histogramWarmup_=1000;
+  referenceStopOnAlarm_=false;
+  asyncWriter_=false;
+  asyncQueueSize_=64;
+  implicitMTEnabled_=false;
+  entryCount_=0;
+  fillSeconds_=0;
+  rollEvents_=0;
+  rollMegabytes_=0;
+  checkpointEvents_=0;
+  resume_=false;
+  inputEventCount_=0;
+  skipEvents_=0;
+  nextCheckpoint_=0;
+  memoryBudgetMB_=0;
+  memoryWarned_=false;
+  shardIndex_=0;
+  shardCount_=0;
+  firstEvent_=0;
+  endEvent_=-1;
+  hfile_=nullptr;
+  treeFile_=nullptr;
+  tree_=nullptr;
+  geometry_manager_=nullptr;
 }
 
 ValidationModule::~ValidationModule() {
@@ -38,85 +124,316 @@ void ValidationModule::initialize(const datatools::properties& myConfig,
     myConfig.fetch("filename_out",this->filename_output_);
   } catch (std::logic_error& e) {
   }
+  // Before anything else uses the output name, because a shard's name says which shard it is
+  SetShards(myConfig);
+  // Calorimeter locations are integers (see CaloLocation.h) unless we ask for the old geomID strings
+  try {
+    myConfig.fetch("calo_string_ids",this->caloStringIds_);
+  } catch (std::logic_error& e) {
+  }
+  SetCaloEnergyBands(myConfig);
+  // Accumulate the tracker and calorimeter maps here, rather than (or as well as) writing every hit
+  try {
+    myConfig.fetch("accumulate_maps",this->accumulateMaps_);
+  } catch (std::logic_error& e) {
+  }
+  try {
+    myConfig.fetch("write_hit_vectors",this->writeHitVectors_);
+  } catch (std::logic_error& e) {
+  }
+  // Quantile sketches of the h_ quantities, written at the end
+  try {
+    myConfig.fetch("quantile_sketches",this->quantileSketches_);
+  } catch (std::logic_error& e) {
+  }
+  try {
+    myConfig.fetch("sketch_relative_accuracy",this->sketchAccuracy_);
+  } catch (std::logic_error& e) {
+  }
+  DT_THROW_IF(sketchAccuracy_<=0 || sketchAccuracy_>=1,
+              std::logic_error,
+              "sketch_relative_accuracy must be between 0 and 1");
+  // Totals of the h_ quantities per run and per time bucket, from the event header
+  try {
+    myConfig.fetch("run_summary",this->runSummary_);
+  } catch (std::logic_error& e) {
+  }
+  try {
+    myConfig.fetch("time_bucket_seconds",this->timeBucketSeconds_);
+  } catch (std::logic_error& e) {
+  }
+  DT_THROW_IF(timeBucketSeconds_<0,
+              std::logic_error,
+              "time_bucket_seconds can't be negative");
+  // The Validation entries of each event topology, so they can be selected without reading the tree
+  try {
+    myConfig.fetch("topology_entry_lists",this->topologyEntryLists_);
+  } catch (std::logic_error& e) {
+  }
+  if (!accumulateMaps_ && !writeHitVectors_)
+  {
+    std::cerr << "write_hit_vectors is false but accumulate_maps is not set, so there will be no tracker or calorimeter maps" << std::endl;
+  }
+  SetCaloPositions(myConfig);
+  trackerCells_.Build(geometry_manager_);
+  SetChannelMonitors(myConfig);
+  SetDetailSampling(myConfig);
+  SetHistograms(myConfig);
+  SetReference(myConfig);
+  SetAsyncWriter(myConfig);
+  SetOutputProfile(myConfig);
+  SetRollingOutput(myConfig);
+  SetCheckpoints(myConfig);
+  SetMemoryBudget(myConfig);
 
   // Use the method of PTD2ROOT to create a root file with just the branches we need for the Validation analysis
 
 
-  hfile_ = new TFile(filename_output_.c_str(),"RECREATE","Output file of Simulation data");
+  // When resuming, carry on writing to the file from the checkpoint
+  const char *fileMode=(resume_ ? "UPDATE" : "RECREATE");
+  if (outputProfile_.HasCompression())
+    hfile_ = new TFile(filename_output_.c_str(),fileMode,"Output file of Simulation data",outputProfile_.GetCompressionSettings());
+  else
+    hfile_ = new TFile(filename_output_.c_str(),fileMode,"Output file of Simulation data");
+  DT_THROW_IF(resume_ && hfile_->IsZombie(),
+              std::logic_error,
+              "Can't resume: could not open " << filename_output_);
   hfile_->cd();
-  tree_ = new TTree("Validation","Validation");
-  tree_->SetDirectory(hfile_);
-
-  // Some basic counts
-  tree_->Branch("h_calorimeter_hit_count",&validation_.h_calorimeter_hit_count_);
-  tree_->Branch("h_calo_hits_over_threshold",&validation_.h_calo_hits_over_threshold_);
-  tree_->Branch("h_cluster_count",&validation_.h_cluster_count_);
-  tree_->Branch("h_track_count",&validation_.h_track_count_);
-  tree_->Branch("h_negative_track_count",&validation_.h_negative_track_count_);
-  tree_->Branch("h_positive_track_count",&validation_.h_positive_track_count_);
-  tree_->Branch("h_associated_track_count",&validation_.h_associated_track_count_);
-  tree_->Branch("h_geiger_hit_count",&validation_.h_geiger_hit_count_);
-  tree_->Branch("v_all_track_hit_counts",&validation_.v_all_track_hit_counts_);
-
-  // Energies and calo times
-  tree_->Branch("h_total_calorimeter_energy",&validation_.h_total_calorimeter_energy_);
-  tree_->Branch("h_calo_energy_over_threshold",&validation_.h_calo_energy_over_threshold_);
-  tree_->Branch("h_unassociated_calorimeter_energy",&validation_.h_unassociated_calorimeter_energy_);
-  tree_->Branch("h_associated_calorimeter_energy",&validation_.h_associated_calorimeter_energy_);
-  tree_->Branch("h_unassociated_energy_over_threshold",&validation_.h_unassociated_energy_over_threshold_);
-  tree_->Branch("h_associated_energy_over_threshold",&validation_.h_associated_energy_over_threshold_);
-  tree_->Branch("h_calo_hit_time_separation",&validation_.h_calo_hit_time_separation_);
-
-  // Tracker maps
-  tree_->Branch("t_cell_hit_count",&validation_.t_cell_hit_count_);
-  // For branches that are per tracker hit, specify the corresponding tracker map variable after the .
-  // This vector needs to have the same number of entries as the one you are mapping
-  // and it specifies the corresponding locations
-  // For example, if you have hits of radius 12mm at (4,5) and =17mm at (6,6)
-  // Your branch here would contain (12,17) and your corresponding map branch would contain
-  // ((4,5),(6,6))
-  // In this example I am mapping all tracker hits to get their average radius
-  // But you could make branches that only include (for example) clustered hits
-  // Just make sure you match the branch with the data to the branch with the corresponding locations
-
-  tree_->Branch("tm_average_drift_radius.t_cell_hit_count",&validation_.tm_average_drift_radius_);
+  // The band maps are sized here and must not be resized after the branches are booked
+  InitializeEventStorage(validation_);
+  InitializeAccumulators(accumulators_);
+  if (resume_)
+  {
+    DT_THROW_IF(!accumulators_.Read(hfile_),
+                std::logic_error,
+                "Can't resume: the checkpointed maps or sketches are missing from " << filename_output_);
+    DT_THROW_IF((histogramOnly_ || !histogramConfig_.empty()) && !histograms_.Read(hfile_),
+                std::logic_error,
+                "Can't resume: the checkpointed histograms are missing from " << filename_output_);
+  }
+  if (histogramOnly_)
+  {
+    this->_set_initialized(true);
+    return;
+  }
 
-  // Calo maps. See this as an example of how to encode a calorimeter location
-  tree_->Branch("c_calorimeter_hit_map",&validation_.c_calorimeter_hit_map_);
-  //
-  tree_->Branch("c_calorimeter_hit_map_low",&validation_.c_calorimeter_hit_map_low_);
-  tree_->Branch("c_calorimeter_hit_map_med",&validation_.c_calorimeter_hit_map_med_);
-  tree_->Branch("c_calorimeter_hit_map_high",&validation_.c_calorimeter_hit_map_high_);
-
-  tree_->Branch("c_calorimeter_hit_map_backscatter",&validation_.c_calorimeter_hit_map_backscatter_);
-
-  //
-  // For branches that are per calorimeter, specify the corresponding calorimeter map variable  after the .
-  // This vector needs to have the same number of entries as the one you are mapping
-  // and it specifies the corresponding locations
-  // For example, if you have hits of 2MeV at calorimeter [1302:0:0:1] and 1 MeV at [1232:0:0:1:15]
-  // Your branch here would contain (2,1) and your corresponding map branch would contain
-  // ([1302:0:0:1],[1232:0:0:1:15])
-  // In this example I am mapping all calorimeter hits to get their average energy
-  // But you could make branches that only include (for example) hits associated with a track -
-  // Just make sure you match the branch with the data to the branch with the corresponding locations
-
-  tree_->Branch ("cm_average_calorimeter_energy.c_calorimeter_hit_map",&validation_.cm_average_calorimeter_energy_);
-
-//changes
-  tree_->Branch("reco.electron_vertex_x",&validation_.electron_vertex_x_); // vector
-  tree_->Branch("reco.electron_vertex_y",&validation_.electron_vertex_y_); // vector
-  tree_->Branch("reco.electron_vertex_z",&validation_.electron_vertex_z_); // vector
-
-  tree_->Branch("reco.track_calo_hits",&validation_.track_calo_hits_);
+  // The writer thread swaps each event into treeStorage_ before filling, so the branches point there
+  if (asyncWriter_) treeStorage_=validation_; // Has the band maps sized already
+  OpenTreeFile(resume_);
+  if (detailFraction_<1 || detailReservoirSize_>0)
+  {
+    // With rolling output the entry numbers are job-wide, so the list isn't tied to one file's tree
+    if (IsRolling()) detailEntries_ = new TEntryList("detail_entries","Validation entries with per-hit details");
+    else detailEntries_ = new TEntryList("detail_entries","Validation entries with per-hit details",tree_);
+  }
+  if (topologyEntryLists_) OpenTopologyEntries(resume_);
 
   this->_set_initialized(true);
 }
+// Create the Validation tree, in a new file if the output is rolling, and start filling it.
+// With resume, carry on filling the tree (in the last file) from the checkpoint instead
+void ValidationModule::OpenTreeFile(bool resume)
+{
+  treeFile_=hfile_;
+  if (IsRolling())
+  {
+    if (!resume)
+    {
+      OutputChunk chunk;
+      chunk.fileName_=GetChunkFileName(chunks_.size());
+      chunk.firstEntry_=entryCount_;
+      chunks_.push_back(chunk);
+    }
+    const char *fileMode=(resume ? "UPDATE" : "RECREATE");
+    if (outputProfile_.HasCompression())
+      treeFile_ = new TFile(chunks_.back().fileName_.c_str(),fileMode,"Validation tree entries",outputProfile_.GetCompressionSettings());
+    else
+      treeFile_ = new TFile(chunks_.back().fileName_.c_str(),fileMode,"Validation tree entries");
+  }
+  treeFile_->cd();
+  if (resume)
+  {
+    tree_=nullptr;
+    treeFile_->GetObject("Validation",tree_);
+    DT_THROW_IF(!tree_,
+                std::logic_error,
+                "Can't resume: there is no Validation tree in " << treeFile_->GetName());
+    Long64_t checkpointEntries=(IsRolling() ? chunks_.back().entryCount_ : entryCount_);
+    DT_THROW_IF(tree_->GetEntries()!=checkpointEntries,
+                std::logic_error,
+                "Can't resume: the Validation tree in " << treeFile_->GetName() << " has " << tree_->GetEntries()
+                << " entries, but the checkpoint has " << checkpointEntries);
+  }
+  else
+  {
+    tree_ = new TTree("Validation","Validation");
+    tree_->SetDirectory(treeFile_);
+  }
+  ValidationEventStorage &branchStorage=(asyncWriter_ ? treeStorage_ : validation_);
+
+  // With a reservoir, the details go in their own tree at the end, so the main tree doesn't have them
+  BookBranches(tree_,branchStorage,writeHitVectors_ && detailReservoirSize_==0,detailReservoirSize_==0,resume);
+  BranchBinder branch={tree_,resume};
+  if (detailFraction_<1)
+  {
+    branch("detail_sampled",&branchStorage.detail_sampled_);
+  }
+  branch("event_topology",&branchStorage.event_topology_);
+  outputProfile_.Apply(tree_);
+  // A checkpoint saves the tree itself. An auto-save in between would leave the file with more
+  // entries than the checkpoint records, and then the job couldn't be resumed
+  if (checkpointEvents_>0) tree_->SetAutoSave(0);
+  // ROOT sizes the baskets to hold a cluster, so keep the clusters well inside the budget. The
+  // cluster size is in compressed bytes, and the baskets hold them uncompressed
+  Long64_t maxClusterBytes=(Long64_t)(memoryBudgetMB_*1e6/4);
+  if (maxClusterBytes>0 && tree_->GetAutoFlush()<-maxClusterBytes) tree_->SetAutoFlush(-maxClusterBytes);
+  fillSeconds_=0;
+  // Nothing else may touch the tree or its file until the writer is drained in CloseTreeFile()
+  if (asyncWriter_) treeWriter_.Start(tree_,&treeStorage_,validation_,asyncQueueSize_);
+  hfile_->cd();
+}
+
+// Finish filling the Validation tree and write it. A rolling output file is closed as well;
+// otherwise the tree is in hfile_, which stays open for the end-of-job objects
+void ValidationModule::CloseTreeFile()
+{
+  treeWriter_.Drain(); // Every queued event is in the tree after this
+  treeFile_->cd();
+  double writeSeconds=(asyncWriter_ ? treeWriter_.GetFillSeconds() : fillSeconds_);
+  std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+  tree_->Write();
+  writeSeconds+=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+  ReportOutput(writeSeconds);
+  if (treeFile_!=hfile_)
+  {
+    treeFile_->Close();
+    delete treeFile_; // And the tree with it
+  }
+  treeFile_=nullptr;
+  tree_=nullptr;
+  hfile_->cd();
+}
+
+// Book the branches of a tree with the Validation layout, pointing at this storage.
+// hitVectors is for the per-hit map branches and electronDetails for the per-electron ones:
+// without them, only the h_ and v_ branches are booked. With existing, the tree was read back
+// from a file, so its branches are pointed at the storage instead of booked
+void ValidationModule::BookBranches(TTree *tree, ValidationEventStorage &storage, bool hitVectors, bool electronDetails, bool existing)
+{
+  BranchBinder branch={tree,existing};
+  // Simple quantities to histogram: counts, energies and calo times
+  const std::vector<ScalarQuantity> &quantities=GetScalarQuantities();
+  for (size_t quantity=0;quantity<quantities.size();++quantity)
+  {
+    const ScalarQuantity &q=quantities[quantity];
+    if (q.doubleMember_) branch(q.name_,&(storage.*q.doubleMember_));
+    else branch(q.name_,&(storage.*q.intMember_));
+  }
+  branch("v_all_track_hit_counts",&storage.v_all_track_hit_counts_);
+
+  // Tracker maps. These are all per hit, so they can be left out if the maps are accumulated
+  if (hitVectors)
+  {
+    branch("t_cell_hit_count",&storage.t_cell_hit_count_);
+    // For branches that are per tracker hit, specify the corresponding tracker map variable after the .
+    // This vector needs to have the same number of entries as the one you are mapping
+    // and it specifies the corresponding locations
+    // For example, if you have hits of radius 12mm at (4,5) and =17mm at (6,6)
+    // Your branch here would contain (12,17) and your corresponding map branch would contain
+    // ((4,5),(6,6))
+    // In this example I am mapping all tracker hits to get their average radius
+    // But you could make branches that only include (for example) clustered hits
+    // Just make sure you match the branch with the data to the branch with the corresponding locations
+
+    branch("tm_average_drift_radius.t_cell_hit_count",&storage.tm_average_drift_radius_);
+
+    // Hits that are on a fitted track, and how far the track passes from their wires
+    // These need the geometry, so they are empty if there's no geometry service
+    branch("t_track_cell_hit_map",&storage.t_track_cell_hit_map_);
+    branch("tm_track_drift_radius.t_track_cell_hit_map",&storage.tm_track_drift_radius_);
+    branch("tm_trajectory_distance.t_track_cell_hit_map",&storage.tm_trajectory_distance_);
+    branch("tm_drift_radius_residual.t_track_cell_hit_map",&storage.tm_drift_radius_residual_);
+    branch("v_track_cell_x",&storage.v_track_cell_x_);
+    branch("v_track_cell_y",&storage.v_track_cell_y_);
+  }
+
+  // Calo maps. See this as an example of how to encode a calorimeter location
+  // The string versions of these are only there for older parsers
+  if (hitVectors)
+  {
+    if (caloStringIds_)
+    {
+      branch("c_calorimeter_hit_map",&storage.c_calorimeter_hit_map_str_);
+      branch("c_calorimeter_hit_map_backscatter",&storage.c_calorimeter_hit_map_backscatter_str_);
+    }
+    else
+    {
+      branch("c_calorimeter_hit_map",&storage.c_calorimeter_hit_map_);
+      branch("c_calorimeter_hit_map_backscatter",&storage.c_calorimeter_hit_map_backscatter_);
+    }
+    // One map per energy band, named from the band definitions
+    for (size_t band=0;band<caloBandNames_.size();++band)
+    {
+      std::string branchName="c_calorimeter_hit_map_"+caloBandNames_.at(band);
+      if (caloStringIds_) branch(branchName.c_str(),&storage.c_calorimeter_hit_map_bands_str_.at(band));
+      else branch(branchName.c_str(),&storage.c_calorimeter_hit_map_bands_.at(band));
+    }
+
+    //
+    // For branches that are per calorimeter, specify the corresponding calorimeter map variable  after the .
+    // This vector needs to have the same number of entries as the one you are mapping
+    // and it specifies the corresponding locations
+    // For example, if you have hits of 2MeV at calorimeter [1302:0.0.0.1] and 1 MeV at [1232:0.0.1.0.15]
+    // Your branch here would contain (2,1) and your corresponding map branch would contain
+    // the encoded locations (1000001,2010015)
+    // In this example I am mapping all calorimeter hits to get their average energy
+    // But you could make branches that only include (for example) hits associated with a track -
+    // Just make sure you match the branch with the data to the branch with the corresponding locations
+
+    branch("cm_average_calorimeter_energy.c_calorimeter_hit_map",&storage.cm_average_calorimeter_energy_);
+  }
+
+  // Per-electron details
+  if (!electronDetails) return;
+  branch("reco.electron_vertex_x",&storage.electron_vertex_x_); // vector
+  branch("reco.electron_vertex_y",&storage.electron_vertex_y_); // vector
+  branch("reco.electron_vertex_z",&storage.electron_vertex_z_); // vector
+
+  if (caloStringIds_) branch("reco.track_calo_hits",&storage.track_calo_hits_str_);
+  else branch("reco.track_calo_hits",&storage.track_calo_hits_);
+}
+
 //! [ValidationModule::Process]
 dpp::base_module::process_status
 ValidationModule::process(datatools::things& workItem) {
+  if (!StartEvent()) return dpp::base_module::PROCESS_OK;
+  dpp::base_module::process_status status=BuildEvent(workItem,validation_,electronTable_,trackBatch_);
+  if (status!=dpp::base_module::PROCESS_OK) return status;
+  return RecordCurrentEvent();
+}
 
+// Call this for every input event, in order, before building it
+bool ValidationModule::StartEvent()
+{
+  // Checkpoint here, once the previous events have been completely dealt with, whatever they returned
+  if (checkpointEvents_>0 && inputEventCount_>=nextCheckpoint_)
+  {
+    WriteCheckpoint();
+    nextCheckpoint_+=checkpointEvents_;
+  }
+  // When resuming, the events up to the checkpoint are already in the output;
+  // and a shard only does its own range of events
+  ++inputEventCount_;
+  return (inputEventCount_>skipEvents_ && IsInEventRange(inputEventCount_-1));
+}
 
+// Fill the event storage from the CD, TCD and PTD banks. This only reads the module's settings
+// and tables, so different threads can build events at the same time, each with its own
+// storage, electron table and track batch
+dpp::base_module::process_status
+ValidationModule::BuildEvent(const datatools::things& workItem, ValidationEventStorage &event, OrderedParticleTable &electronTable,
+                             TrackBatch &trackBatch) const
+{
   // declare internal variables to mimic the ntuple variables, names are same but in camel case
   double totalCalorimeterEnergy=0;
   double energyOverThreshold=0;
@@ -125,6 +442,8 @@ ValidationModule::process(datatools::things& workItem) {
   double timeDelay=-1;
   int clusterCount=0;
   int trackCount=0;
+  int electronCount=0;
+  int gammaCount=0;
   int alphaCount=0;
   int associatedTrackCount=0;
   int caloHitCount=0;
@@ -136,13 +455,21 @@ ValidationModule::process(datatools::things& workItem) {
   int positiveTrackCount=0;
   std::vector<int> allTrackHitCounts;
 
-//changes
-  std::vector<double> electronEnergies;
-  std::vector<TVector3> electronVertices;
+  // Electrons for the per-electron branches, which are all sorted by energy at the end
+  electronTable.Clear();
+  trackBatch.Clear();
 
 
   // We need to run this before we start populating vectors. Put all your vectors in this function to clear them
-  ResetVars();
+  ResetVars(event);
+
+  // The run number and time are for the run and time summaries, and the index of rolling output files
+  try {
+    const snemo::datamodel::event_header& header = workItem.get<snemo::datamodel::event_header>("EH");
+    event.run_number_=header.get_id().get_run_number();
+    if (header.get_timestamp().is_valid()) event.timestamp_=header.get_timestamp().get_seconds();
+  } catch (std::logic_error& e) {
+  }
 
   // Grab calibrated data bank
   // Calibrated data will only be present in reconstructed files,
@@ -161,26 +488,26 @@ ValidationModule::process(datatools::things& workItem) {
           const snemo::datamodel::calibrated_calorimeter_hit & calHit = iHit->get();
 
           // Write to the calorimeter map
-          validation_.c_calorimeter_hit_map_.push_back(EncodeLocation(calHit));
-          validation_.c_calorimeter_hit_map_backscatter_.push_back(EncodeLocation(calHit));
+          int location=EncodeLocation(calHit);
+          event.c_calorimeter_hit_map_.push_back(location);
+          event.c_calorimeter_hit_map_backscatter_.push_back(location);
 
           double energy=calHit.get_energy();
 
-          if(energy < 0.5){
-              validation_.c_calorimeter_hit_map_low_.push_back(EncodeLocation(calHit));
-              //std::cout << "Low " << energy << std::endl;
-            }
-          if((energy > 0.5) && (energy < 1.5)){
-              validation_.c_calorimeter_hit_map_med_.push_back(EncodeLocation(calHit));
-              //std::cout << "Med " << energy << std::endl;
-            }
-          if(energy > 1.5){
-              validation_.c_calorimeter_hit_map_high_.push_back(EncodeLocation(calHit));
-              //std::cout << "High " << energy << std::endl;
-            }
+          // Energy band maps
+          size_t band=GetCaloEnergyBand(energy);
+          event.c_calorimeter_hit_map_bands_[band].push_back(location);
+
+          if (caloStringIds_)
+          {
+            std::string locationString=EncodeCaloLocationString(calHit);
+            event.c_calorimeter_hit_map_str_.push_back(locationString);
+            event.c_calorimeter_hit_map_backscatter_str_.push_back(locationString);
+            event.c_calorimeter_hit_map_bands_str_[band].push_back(locationString);
+          }
 
           // Write to the energy vector
-          validation_.cm_average_calorimeter_energy_.push_back(energy);
+          event.cm_average_calorimeter_energy_.push_back(energy);
 
           totalCalorimeterEnergy += energy;
           if (energy > LOW_ENERGY_LIMIT)
@@ -212,9 +539,9 @@ ValidationModule::process(datatools::things& workItem) {
           // Get the location of the tracker hit
           const snemo::datamodel::calibrated_tracker_hit & hit = iHit->get();
           // Encode it into an integer so we can easily put it in an ntuple branch
-          validation_.t_cell_hit_count_.push_back(EncodeLocation (hit));
+          event.t_cell_hit_count_.push_back(EncodeLocation (hit));
           // Vector of radii for mapping
-          validation_.tm_average_drift_radius_.push_back(hit.get_r());
+          event.tm_average_drift_radius_.push_back(hit.get_r());
         }
       }
     }
@@ -229,12 +556,9 @@ ValidationModule::process(datatools::things& workItem) {
     const snemo::datamodel::tracker_clustering_data& clusterData = workItem.get<snemo::datamodel::tracker_clustering_data>("TCD");
     if (clusterData.has_default_solution ()) // Looks as if there is a possibility of alternative solutions. Is it sufficient to use the default?
       {
-        snemo::datamodel::tracker_clustering_solution solution = clusterData.get_default_solution () ;
-        snemo::datamodel::tracker_clustering_solution::cluster_col_type clusters=solution.get_clusters();
-        for (snemo::datamodel::tracker_clustering_solution::cluster_col_type::const_iterator iCluster = clusters.begin();  iCluster != clusters.end(); ++ iCluster)
-        {
-          ++clusterCount;
-        }
+        const snemo::datamodel::tracker_clustering_solution & solution = clusterData.get_default_solution () ;
+        const snemo::datamodel::tracker_clustering_solution::cluster_col_type & clusters=solution.get_clusters();
+        clusterCount = clusters.size();
       }
   }
   catch (std::logic_error& e) {
@@ -252,24 +576,44 @@ ValidationModule::process(datatools::things& workItem) {
     const snemo::datamodel::particle_track_data& trackData = workItem.get<snemo::datamodel::particle_track_data>("PTD");
     if (trackData.has_particles ())
     {
+      // Work out the track details for all the particles at once
+      trackBatch.Initialize(geometry_manager_, trackData);
+      if (caloPositions_.IsFilled()) trackBatch.SetCaloPositions(&caloPositions_);
       for (uint iParticle=0;iParticle<trackData.get_number_of_particles();++iParticle)
       {
-        snemo::datamodel::particle_track track=trackData.get_particle(iParticle);
+        const snemo::datamodel::particle_track & track=trackData.get_particle(iParticle);
 
 //start of change
-        TrackDetails trackDetails(geometry_manager_, track);
+        TrackDetails trackDetails(&trackBatch, iParticle);
 
+        // For the event topology
         if (trackDetails.IsElectron())
         {
-         int pos=InsertAndGetPosition(trackDetails.GetEnergy(), electronEnergies, true);
-         InsertAt(trackDetails.GetFoilmostVertex(),electronVertices,pos);
-
-         const snemo::datamodel::calibrated_data::calorimeter_hit_collection_type & calHits= track.get_associated_calorimeter_hits();
-         for (snemo::datamodel::calibrated_data::calorimeter_hit_collection_type::const_iterator   iHit = calHits.begin(); iHit != calHits.end(); ++iHit) {
-           const snemo::datamodel::calibrated_calorimeter_hit & calHit = iHit->get();
-           //std::cout<< "Calo track hit is: " << EncodeLocation(calHit) <<std::endl;
-           //validation_.c_calorimeter_hit_map_backscatter_.push_back(EncodeLocation(calHit));
-           validation_.track_calo_hits_.push_back(EncodeLocation(calHit));
+          electronCount++;
+          if (trackDetails.IsPositron()) event.event_topology_|=TOPOLOGY_POSITRON;
+        }
+        else if (trackDetails.IsGamma()) gammaCount++;
+        else if (trackDetails.IsAlpha()) alphaCount++;
+        else event.event_topology_|=TOPOLOGY_UNKNOWN;
+
+        if (trackDetails.IsElectron())
+        {
+         electronTable.AddParticle(trackDetails.GetEnergy(), trackDetails.GetTime(), trackDetails.GetFoilmostVertex());
+         if (caloStringIds_)
+         {
+           const snemo::datamodel::calibrated_data::calorimeter_hit_collection_type & calHits= track.get_associated_calorimeter_hits();
+           for (unsigned int hit=0; hit<calHits.size();++hit)
+           {
+             electronTable.AddCaloHit(EncodeCaloLocationString(calHits.at(hit).get()));
+           }
+         }
+         else
+         {
+           // The batch has already encoded the associated hit locations
+           for (size_t hit=trackBatch.caloHitIdStart_[iParticle];hit<trackBatch.caloHitIdStart_[iParticle+1];++hit)
+           {
+             electronTable.AddCaloHit(trackBatch.caloHitIds_[hit]);
+           }
          }
         }
 
@@ -313,16 +657,9 @@ ValidationModule::process(datatools::things& workItem) {
         // See if it has associated energy
         if (track.get_charge() != snemo::datamodel::particle_track::NEUTRAL)
         {
-          for (unsigned int hit=0; hit<track.get_associated_calorimeter_hits().size();++hit)
-          {
-            const snemo::datamodel::calibrated_calorimeter_hit & calo_hit = track.get_associated_calorimeter_hits().at(hit).get();
-            double energy=calo_hit.get_energy();
-            associatedEnergy+=energy;
-            if (energy > LOW_ENERGY_LIMIT)
-            {
-              assocOverThreshold += energy;
-            }
-          }
+          trackBatch.EnsureCaloHits(); // Sums over the associated hits
+          associatedEnergy+=trackBatch.associatedEnergy_[iParticle];
+          assocOverThreshold+=trackBatch.associatedEnergyOverThreshold_[iParticle];
         }
 
         // Number of tracker hits
@@ -332,6 +669,7 @@ ValidationModule::process(datatools::things& workItem) {
         if (numHits>0)
         {
           allTrackHitCounts.push_back(numHits); // Vector of hits per track
+          AddTrackResiduals(trackBatch, iParticle, event);
           // Is the track associated to a calorimeter hit?
           if (track.has_associated_calorimeter_hits())
           {
@@ -346,128 +684,1034 @@ ValidationModule::process(datatools::things& workItem) {
     return dpp::base_module::PROCESS_INVALID;
   } //end catch
 
-  validation_.h_total_calorimeter_energy_ = totalCalorimeterEnergy;
-  validation_.h_calo_energy_over_threshold_ = energyOverThreshold;
+  event.h_total_calorimeter_energy_ = totalCalorimeterEnergy;
+  event.h_calo_energy_over_threshold_ = energyOverThreshold;
 
   // Unassociated calorimeter energy is the total energy of the gammas
 
-  validation_.h_associated_calorimeter_energy_ = associatedEnergy;
-  validation_.h_associated_energy_over_threshold_ = assocOverThreshold;
-  validation_.h_unassociated_calorimeter_energy_ = totalCalorimeterEnergy-associatedEnergy;
-  validation_.h_unassociated_energy_over_threshold_ = energyOverThreshold - assocOverThreshold;
+  event.h_associated_calorimeter_energy_ = associatedEnergy;
+  event.h_associated_energy_over_threshold_ = assocOverThreshold;
+  event.h_unassociated_calorimeter_energy_ = totalCalorimeterEnergy-associatedEnergy;
+  event.h_unassociated_energy_over_threshold_ = energyOverThreshold - assocOverThreshold;
 
   // Timing
-  validation_.h_calo_hit_time_separation_=TMath::Abs(timeDelay);
+  event.h_calo_hit_time_separation_=TMath::Abs(timeDelay);
 
   // Counts
-  validation_.h_calorimeter_hit_count_=caloHitCount;
-  validation_.h_calo_hits_over_threshold_=nCalHitsOverLowLimit;
-  validation_.h_geiger_hit_count_=geigerHitCount;
-  validation_.h_cluster_count_=clusterCount;
-  validation_.h_track_count_=trackCount;
-  validation_.h_associated_track_count_=associatedTrackCount;
-  validation_.h_negative_track_count_=negativeTrackCount;
-  validation_.h_positive_track_count_=positiveTrackCount;
-  validation_.v_all_track_hit_counts_=allTrackHitCounts;
+  event.h_calorimeter_hit_count_=caloHitCount;
+  event.h_calo_hits_over_threshold_=nCalHitsOverLowLimit;
+  event.h_geiger_hit_count_=geigerHitCount;
+  event.h_cluster_count_=clusterCount;
+  event.h_track_count_=trackCount;
+  event.h_associated_track_count_=associatedTrackCount;
+  event.h_negative_track_count_=negativeTrackCount;
+  event.h_positive_track_count_=positiveTrackCount;
+  event.v_all_track_hit_counts_=allTrackHitCounts;
+  event.event_topology_|=EventTopology(electronCount,gammaCount,alphaCount);
+
+  // Per-electron branches, highest energy first. They all use the same order
+  electronTable.SortByEnergy(true);
+  electronTable.AppendOrdered(electronTable.vertexX_, event.electron_vertex_x_);
+  electronTable.AppendOrdered(electronTable.vertexY_, event.electron_vertex_y_);
+  electronTable.AppendOrdered(electronTable.vertexZ_, event.electron_vertex_z_);
+  // Only one of the calo hit columns is filled, and the offsets are for that one
+  if (caloStringIds_) electronTable.AppendOrderedGroups(electronTable.caloHitIdStrings_, event.track_calo_hits_str_);
+  else electronTable.AppendOrderedGroups(electronTable.caloHitIds_, event.track_calo_hits_);
+  return dpp::base_module::PROCESS_OK;
+}
 
-//added branches
-for (int i=0;i<electronVertices.size();i++)
+// Add a built event to everything that is written: the accumulators, monitors, histograms,
+// reference comparison and the tree. Events must be recorded in input order. The event's
+// contents are swapped with a recycled buffer
+dpp::base_module::process_status ValidationModule::RecordEvent(ValidationEventStorage &event)
 {
-  validation_.electron_vertex_x_.push_back(electronVertices.at(i).X());
-  validation_.electron_vertex_y_.push_back(electronVertices.at(i).Y());
-  validation_.electron_vertex_z_.push_back(electronVertices.at(i).Z());
+  SwapEventStorage(event,validation_);
+  return RecordCurrentEvent();
 }
 
-
-  tree_->Fill();
+dpp::base_module::process_status ValidationModule::RecordCurrentEvent()
+{
+  accumulators_.Fill(validation_);
+  if (monitorChannels_)
+  {
+    trackerMonitor_.Fill(validation_.t_cell_hit_count_);
+    caloMonitor_.Fill(validation_.c_calorimeter_hit_map_);
+  }
+  if (histogramOnly_ || !histogramConfig_.empty()) histograms_.Fill(validation_);
+  bool referenceAlarm=(!referenceFile_.empty() && referenceComparator_.Fill(validation_));
+  // Everything above sees the full event; sampling only changes what is written
+  if (tree_) FillTree(); // Not with histogram_only
+  if (inputEventCount_%MEMORY_CHECK_EVENTS==0) CheckMemory();
+  if (referenceAlarm && referenceStopOnAlarm_)
+  {
+    std::cerr << "Stopping: the distributions have diverged from the reference" << std::endl;
+    return dpp::base_module::PROCESS_FATAL;
+  }
   // MUST return a status, see ref dpp::processing_status_flags_type
   return dpp::base_module::PROCESS_OK;
 }
 
 
-void ValidationModule::ResetVars()
+void ValidationModule::InitializeEventStorage(ValidationEventStorage &event) const
 {
-  validation_.v_all_track_hit_counts_.clear();
-  validation_.t_cell_hit_count_.clear();
-  validation_.c_calorimeter_hit_map_.clear();
-  validation_.c_calorimeter_hit_map_low_.clear();
-  validation_.c_calorimeter_hit_map_med_.clear();
-  validation_.c_calorimeter_hit_map_high_.clear();
-  validation_.c_calorimeter_hit_map_backscatter_.clear();
-  validation_.cm_average_calorimeter_energy_.clear();
-  validation_.tm_average_drift_radius_.clear();
-
-  validation_.electron_vertex_x_.clear();
-  validation_.electron_vertex_y_.clear();
-  validation_.electron_vertex_z_.clear();
+  event.c_calorimeter_hit_map_bands_.assign(caloBandNames_.size(),std::vector<int>());
+  event.c_calorimeter_hit_map_bands_str_.assign(caloBandNames_.size(),std::vector<std::string>());
+}
 
-  validation_.track_calo_hits_.clear();
+void ValidationModule::InitializeAccumulators(ValidationAccumulators &accumulators) const
+{
+  accumulators.Initialize(accumulateMaps_,caloBandNames_,quantileSketches_,sketchAccuracy_,runSummary_,timeBucketSeconds_);
 }
 
-int ValidationModule::EncodeLocation(const snemo::datamodel::calibrated_tracker_hit & hit)
+Long64_t ValidationModule::GetSkipEvents() const
 {
-  int encodedLocation=hit.get_layer() + 100 * hit.get_row(); // There are fewer than 100 layers so this is OK
-  if (hit.get_side()==0) encodedLocation = (-1 * encodedLocation) - 1;
-  // Negative numbers are Italy side, positive are France side
-  // layers are 0 to 8 with 0 being at the source foil and 8 by the main wall
-  // rows go from 0 (mountain) to 112 (tunnel)
-  return encodedLocation;
+  return std::max(skipEvents_,firstEvent_);
 }
 
+Long64_t ValidationModule::GetEndEvent() const
+{
+  return endEvent_;
+}
 
-string ValidationModule::EncodeLocation(const snemo::datamodel::calibrated_calorimeter_hit & hit)
-{ // Returns the geomID as a string ready for decoding
-  std::stringstream buffer;
-  buffer << hit.get_geom_id();
-  return buffer.str();
+void ValidationModule::ResetVars(ValidationEventStorage &event)
+{
+  event.v_all_track_hit_counts_.clear();
+  event.detail_sampled_=true;
+  event.event_topology_=0;
+  event.run_number_=-1;
+  event.timestamp_=-1;
+  ClearDetail(event);
 }
 
-//changes
-int ValidationModule::InsertAndGetPosition(double toInsert, std::vector<double> &vec, bool highestFirst)
+// Clear the per-hit and per-electron vectors: everything but the h_ and v_ branches
+void ValidationModule::ClearDetail(ValidationEventStorage &storage)
 {
-  std::vector<double>::iterator it;
-  int len=vec.size();
+  storage.t_cell_hit_count_.clear();
+  storage.c_calorimeter_hit_map_.clear();
+  for (size_t band=0;band<storage.c_calorimeter_hit_map_bands_.size();++band)
+    storage.c_calorimeter_hit_map_bands_[band].clear();
+  storage.c_calorimeter_hit_map_backscatter_.clear();
+  storage.cm_average_calorimeter_energy_.clear();
+  storage.tm_average_drift_radius_.clear();
+  storage.t_track_cell_hit_map_.clear();
+  storage.tm_track_drift_radius_.clear();
+  storage.tm_trajectory_distance_.clear();
+  storage.tm_drift_radius_residual_.clear();
+  storage.v_track_cell_x_.clear();
+  storage.v_track_cell_y_.clear();
+
+  storage.electron_vertex_x_.clear();
+  storage.electron_vertex_y_.clear();
+  storage.electron_vertex_z_.clear();
+
+  storage.track_calo_hits_.clear();
+
+  storage.c_calorimeter_hit_map_str_.clear();
+  for (size_t band=0;band<storage.c_calorimeter_hit_map_bands_str_.size();++band)
+    storage.c_calorimeter_hit_map_bands_str_[band].clear();
+  storage.c_calorimeter_hit_map_backscatter_str_.clear();
+  storage.track_calo_hits_str_.clear();
+}
 
-  it=vec.begin();
-  for (int i=0;i<len;i++)
+// Read the calorimeter energy band edges (MeV) and optionally their names from the config
+// By default there are three bands, low (below 0.5 MeV), med and high (1.5 MeV and above)
+void ValidationModule::SetCaloEnergyBands(const datatools::properties& myConfig)
+{
+  caloBandEdges_.clear();
+  caloBandNames_.clear();
+  try {
+    myConfig.fetch("calo_energy_bands",caloBandEdges_);
+  } catch (std::logic_error& e) {
+    caloBandEdges_={0.5,1.5};
+    caloBandNames_={"low","med","high"};
+  }
+  for (size_t edge=1;edge<caloBandEdges_.size();++edge)
+  {
+    DT_THROW_IF(caloBandEdges_.at(edge)<=caloBandEdges_.at(edge-1),
+                std::logic_error,
+                "calo_energy_bands must be in increasing order");
+  }
+  if (myConfig.has_key("calo_energy_band_names"))
   {
-    if ((highestFirst && (toInsert > vec.at(i))) || (!highestFirst && (toInsert < vec.at(i))))
+    myConfig.fetch("calo_energy_band_names",caloBandNames_);
+    DT_THROW_IF(caloBandNames_.size()!=caloBandEdges_.size()+1,
+                std::logic_error,
+                "calo_energy_band_names needs one more entry than calo_energy_bands");
+    // Each name makes a c_calorimeter_hit_map_<name> branch, which mustn't clash with another branch
+    for (size_t band=0;band<caloBandNames_.size();++band)
     {
-      vec.insert(std::next(it,i),toInsert);
-      return i;
+      const std::string &name=caloBandNames_.at(band);
+      DT_THROW_IF(name.empty() || name.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_")!=std::string::npos,
+                  std::logic_error,
+                  "calo_energy_band_names can only have letters, digits and underscores, not '" << name << "'");
+      DT_THROW_IF(name=="backscatter",
+                  std::logic_error,
+                  "The calorimeter energy band name 'backscatter' is taken by c_calorimeter_hit_map_backscatter");
+      DT_THROW_IF(std::count(caloBandNames_.begin(),caloBandNames_.end(),name)>1,
+                  std::logic_error,
+                  "The calorimeter energy band name '" << name << "' is used more than once");
     }
   }
-  vec.push_back(toInsert);
-  return -1; // It needs adding at the end
+  if (!caloBandNames_.empty()) return;
+
+  // Generate names like lt0p5MeV, 0p5to1p5MeV, ge1p5MeV (. isn't allowed in a branch name)
+  std::vector<std::string> edgeNames;
+  for (size_t edge=0;edge<caloBandEdges_.size();++edge)
+  {
+    char buffer[32];
+    snprintf(buffer,sizeof(buffer),"%g",caloBandEdges_.at(edge));
+    std::string edgeName=buffer;
+    std::replace(edgeName.begin(),edgeName.end(),'.','p');
+    std::replace(edgeName.begin(),edgeName.end(),'-','m');
+    edgeNames.push_back(edgeName);
+  }
+  if (edgeNames.empty())
+  {
+    caloBandNames_.push_back("all");
+    return;
+  }
+  caloBandNames_.push_back("lt"+edgeNames.front()+"MeV");
+  for (size_t edge=1;edge<edgeNames.size();++edge)
+  {
+    caloBandNames_.push_back(edgeNames.at(edge-1)+"to"+edgeNames.at(edge)+"MeV");
+  }
+  caloBandNames_.push_back("ge"+edgeNames.back()+"MeV");
 }
 
-template <typename T>
-void ValidationModule::InsertAt(T toInsert, std::vector<T> &vec, int position)
+// Fill the calorimeter position table. If calo_position_table is set, load it from that file,
+// or if that fails (no file, or a different geometry) build it from the geometry and save it there
+void ValidationModule::SetCaloPositions(const datatools::properties& myConfig)
 {
-  if (position>vec.size() || position==-1 )
+  caloPositions_.Clear();
+  caloPositionFile_="";
+  if (!geometry_manager_) return;
+  try {
+    myConfig.fetch("calo_position_table",caloPositionFile_);
+  } catch (std::logic_error& e) {
+  }
+  if (!caloPositionFile_.empty()
+      && caloPositions_.Load(caloPositionFile_,geometry_manager_->get_setup_label(),geometry_manager_->get_setup_version()))
   {
-    vec.push_back(toInsert);
+    std::cout << "Read calorimeter positions from " << caloPositionFile_ << std::endl;
     return;
   }
+  caloPositions_.Build(geometry_manager_);
+  if (!caloPositionFile_.empty()) caloPositions_.Save(caloPositionFile_);
+}
+
+// Set up the hot and dead channel monitors, if monitor_channels is set.
+// The other keys override the defaults in RateMonitorSettings
+void ValidationModule::SetChannelMonitors(const datatools::properties& myConfig)
+{
+  monitorSettings_=RateMonitorSettings();
+  try {
+    myConfig.fetch("monitor_channels",this->monitorChannels_);
+  } catch (std::logic_error& e) {
+  }
+  if (!monitorChannels_) return;
+  try {
+    myConfig.fetch("monitor_window_events",monitorSettings_.windowEvents_);
+  } catch (std::logic_error& e) {
+  }
+  try {
+    myConfig.fetch("monitor_history_windows",monitorSettings_.historyWindows_);
+  } catch (std::logic_error& e) {
+  }
+  try {
+    myConfig.fetch("monitor_hot_factor",monitorSettings_.hotFactor_);
+  } catch (std::logic_error& e) {
+  }
+  try {
+    myConfig.fetch("monitor_dead_factor",monitorSettings_.deadFactor_);
+  } catch (std::logic_error& e) {
+  }
+  try {
+    myConfig.fetch("monitor_min_hits",monitorSettings_.minHits_);
+  } catch (std::logic_error& e) {
+  }
+  DT_THROW_IF(monitorSettings_.windowEvents_<1 || monitorSettings_.historyWindows_<1,
+              std::logic_error,
+              "monitor_window_events and monitor_history_windows must be at least 1");
+  DT_THROW_IF(monitorSettings_.hotFactor_<=1 || monitorSettings_.deadFactor_<0 || monitorSettings_.deadFactor_>=1,
+              std::logic_error,
+              "monitor_hot_factor must be more than 1 and monitor_dead_factor between 0 and 1");
+  trackerMonitor_.Initialize("t_cell_hit_count",TRACKER_CELL_COUNT,TrackerDenseIndex,TrackerLocationFromDenseIndex,
+                             ChannelRateMonitor::TrackerNeighbours(),monitorSettings_);
+  caloMonitor_.Initialize("c_calorimeter_hit_map",CALO_BLOCK_COUNT,CaloDenseIndex,CaloLocationFromDenseIndex,
+                          ChannelRateMonitor::CaloNeighbours(),monitorSettings_);
+}
+
+// Either keep the details for a fraction of events (detail_sample_fraction), chosen at random as they come,
+// or for a uniform random sample of a fixed number of events (detail_reservoir_size), which are written
+// to the ValidationDetail tree at the end
+void ValidationModule::SetDetailSampling(const datatools::properties& myConfig)
+{
+  try {
+    myConfig.fetch("detail_sample_fraction",this->detailFraction_);
+  } catch (std::logic_error& e) {
+  }
+  try {
+    myConfig.fetch("detail_reservoir_size",this->detailReservoirSize_);
+  } catch (std::logic_error& e) {
+  }
+  try {
+    myConfig.fetch("detail_sample_seed",this->detailSeed_);
+  } catch (std::logic_error& e) {
+  }
+  DT_THROW_IF(detailFraction_<=0 || detailFraction_>1,
+              std::logic_error,
+              "detail_sample_fraction must be more than 0 and at most 1");
+  DT_THROW_IF(detailReservoirSize_<0,
+              std::logic_error,
+              "detail_reservoir_size can't be negative");
+  DT_THROW_IF(detailFraction_<1 && detailReservoirSize_>0,
+              std::logic_error,
+              "Use either detail_sample_fraction or detail_reservoir_size, not both");
+  // Each shard has its own seed, so that the shards don't all sample the same positions in their slices
+  if (IsSharded()) detailSeed_+=(shardCount_>0 ? shardIndex_ : firstEvent_);
+  detailRandom_.SetSeed(detailSeed_);
+  reservoir_.clear();
+  reservoirEntries_.clear();
+  reservoir_.reserve(detailReservoirSize_);
+  reservoirEntries_.reserve(detailReservoirSize_);
+}
+
+// Histograms of the h_ quantities, binned from histogram_config, or auto-ranged after
+// histogram_warmup_events events. With histogram_only, these are written instead of the tree
+void ValidationModule::SetHistograms(const datatools::properties& myConfig)
+{
+  try {
+    myConfig.fetch("histogram_only",this->histogramOnly_);
+  } catch (std::logic_error& e) {
+  }
+  try {
+    myConfig.fetch("histogram_config",this->histogramConfig_);
+  } catch (std::logic_error& e) {
+  }
+  try {
+    myConfig.fetch("histogram_warmup_events",this->histogramWarmup_);
+  } catch (std::logic_error& e) {
+  }
+  DT_THROW_IF(histogramWarmup_<1,
+              std::logic_error,
+              "histogram_warmup_events must be at least 1");
+  DT_THROW_IF(histogramOnly_ && (detailFraction_<1 || detailReservoirSize_>0),
+              std::logic_error,
+              "There is no per-event detail to sample with histogram_only");
+  if (histogramOnly_ || !histogramConfig_.empty()) histograms_.Initialize(histogramConfig_,histogramWarmup_);
+}
+
+// Compare with the distributions in reference_file as we go. See ReferenceComparator for what it needs
+void ValidationModule::SetReference(const datatools::properties& myConfig)
+{
+  referenceFile_="";
+  ReferenceSettings settings;
+  try {
+    myConfig.fetch("reference_file",this->referenceFile_);
+  } catch (std::logic_error& e) {
+  }
+  if (referenceFile_.empty()) return;
+  try {
+    myConfig.fetch("reference_check_events",settings.checkEvents_);
+  } catch (std::logic_error& e) {
+  }
+  try {
+    myConfig.fetch("reference_min_chi2_probability",settings.minChi2Probability_);
+  } catch (std::logic_error& e) {
+  }
+  try {
+    myConfig.fetch("reference_max_ks_distance",settings.maxKSDistance_);
+  } catch (std::logic_error& e) {
+  }
+  try {
+    myConfig.fetch("reference_stop_on_alarm",this->referenceStopOnAlarm_);
+  } catch (std::logic_error& e) {
+  }
+  DT_THROW_IF(settings.checkEvents_<1,
+              std::logic_error,
+              "reference_check_events must be at least 1");
+  DT_THROW_IF(referenceComparator_.Initialize(referenceFile_,settings)==0,
+              std::logic_error,
+              "No reference distributions in " << referenceFile_);
+}
+
+// Write the event to the Validation tree, or hand it to the writer thread. Either way,
+// validation_ is cleared by ResetVars before the next event
+void ValidationModule::FillTree()
+{
+  if (NeedsNewTreeFile())
+  {
+    CloseTreeFile();
+    OpenTreeFile(false);
+  }
+  if (detailEntries_) SampleDetail();
+  if (!topologyEntries_.empty())
+  {
+    int topology=TopologyIndex(validation_.event_topology_);
+    if (topology>=0) topologyEntries_[topology]->Enter(entryCount_);
+  }
+  if (IsRolling())
+  {
+    ++chunks_.back().entryCount_;
+    chunks_.back().runs_.insert(validation_.run_number_);
+  }
+  if (asyncWriter_) treeWriter_.Push(validation_);
   else
   {
-    typename std::vector<T>::iterator it=vec.begin();
-    vec.insert(std::next(it,position),toInsert);
+    std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+    tree_->Fill();
+    fillSeconds_+=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+  }
+  ++entryCount_;
+}
+
+// Fill the Validation tree on its own thread. The events are written in the same order,
+// so the file is the same as without it
+void ValidationModule::SetAsyncWriter(const datatools::properties& myConfig)
+{
+  try {
+    myConfig.fetch("async_writer",this->asyncWriter_);
+  } catch (std::logic_error& e) {
+  }
+  try {
+    myConfig.fetch("async_queue_size",this->asyncQueueSize_);
+  } catch (std::logic_error& e) {
+  }
+  DT_THROW_IF(asyncQueueSize_<1,
+              std::logic_error,
+              "async_queue_size must be at least 1");
+  // ROOT keeps global state (gDirectory, the type system) that both threads will use
+  if (asyncWriter_) ROOT::EnableThreadSafety();
+}
+
+// Compression, basket sizes and flush cadence: start from the named output_profile, then change
+// any individual setting. See OutputProfile.h for the profiles
+void ValidationModule::SetOutputProfile(const datatools::properties& myConfig)
+{
+  std::string profileName="default";
+  try {
+    myConfig.fetch("output_profile",profileName);
+  } catch (std::logic_error& e) {
+  }
+  DT_THROW_IF(!outputProfile_.SetNamed(profileName),
+              std::logic_error,
+              "Unknown output_profile " << profileName);
+  std::string algorithmName;
+  try {
+    myConfig.fetch("output_compression_algorithm",algorithmName);
+  } catch (std::logic_error& e) {
+  }
+  DT_THROW_IF(!algorithmName.empty() && !OutputProfile::ParseAlgorithm(algorithmName,outputProfile_.compressionAlgorithm_),
+              std::logic_error,
+              "Unknown output_compression_algorithm " << algorithmName);
+  try {
+    myConfig.fetch("output_compression_level",outputProfile_.compressionLevel_);
+  } catch (std::logic_error& e) {
+  }
+  try {
+    myConfig.fetch("output_scalar_basket_size",outputProfile_.scalarBasketSize_);
+  } catch (std::logic_error& e) {
+  }
+  try {
+    myConfig.fetch("output_vector_basket_size",outputProfile_.vectorBasketSize_);
+  } catch (std::logic_error& e) {
+  }
+  // The properties only hold ints, which is enough for the cadences
+  int cadence;
+  try {
+    myConfig.fetch("output_auto_flush",cadence);
+    outputProfile_.autoFlush_=cadence;
+  } catch (std::logic_error& e) {
+  }
+  try {
+    myConfig.fetch("output_auto_save",cadence);
+    outputProfile_.autoSave_=cadence;
+  } catch (std::logic_error& e) {
+  }
+  try {
+    myConfig.fetch("output_implicit_mt_threads",outputProfile_.implicitMTThreads_);
+  } catch (std::logic_error& e) {
+  }
+  DT_THROW_IF(outputProfile_.compressionLevel_>9,
+              std::logic_error,
+              "output_compression_level must be at most 9");
+  // Baskets are then compressed in parallel when they are flushed. If something else has turned it
+  // on already, it is left as it is, and left on at the end
+  if (outputProfile_.implicitMTThreads_>0 && !ROOT::IsImplicitMTEnabled())
+  {
+    ROOT::EnableImplicitMT(outputProfile_.implicitMTThreads_);
+    implicitMTEnabled_=true;
+  }
+}
+
+// Print how fast the Validation tree was written and how well it compressed, to compare output profiles
+void ValidationModule::ReportOutput(double writeSeconds)
+{
+  const double MB=1e6;
+  double treeMB=tree_->GetTotBytes()/MB; // Before compression
+  double zipMB=tree_->GetZipBytes()/MB;
+  std::cout << "Output profile " << outputProfile_.name_ << ", " << treeFile_->GetName() << ": "
+            << tree_->GetEntries() << " events, " << treeMB << " MB of tree data written in " << writeSeconds << " s";
+  if (writeSeconds>0) std::cout << " (" << treeMB/writeSeconds << " MB/s)";
+  std::cout << ", " << zipMB << " MB on disk";
+  if (zipMB>0) std::cout << " (compression factor " << treeMB/zipMB << ")";
+  std::cout << std::endl;
+}
+
+// Split the Validation tree into numbered files of roll_events events or roll_megabytes
+// compressed megabytes, whichever comes first, with an index of what is in each
+void ValidationModule::SetRollingOutput(const datatools::properties& myConfig)
+{
+  try {
+    myConfig.fetch("roll_events",this->rollEvents_);
+  } catch (std::logic_error& e) {
+  }
+  try {
+    myConfig.fetch("roll_megabytes",this->rollMegabytes_);
+  } catch (std::logic_error& e) {
+  }
+  DT_THROW_IF(rollEvents_<0 || rollMegabytes_<0,
+              std::logic_error,
+              "roll_events and roll_megabytes can't be negative");
+  DT_THROW_IF(IsRolling() && histogramOnly_,
+              std::logic_error,
+              "There is no Validation tree to roll over with histogram_only");
+  chunks_.clear();
+}
+
+bool ValidationModule::IsRolling() const
+{
+  return (rollEvents_>0 || rollMegabytes_>0);
+}
+
+// Validation.root without its extension, for the names of the other files
+std::string ValidationModule::GetOutputStem() const
+{
+  size_t dot=filename_output_.rfind('.');
+  if (dot==std::string::npos || filename_output_.find('/',dot)!=std::string::npos) return filename_output_;
+  return filename_output_.substr(0,dot);
+}
+
+// Validation.root is split into Validation_0000.root, Validation_0001.root...
+std::string ValidationModule::GetChunkFileName(size_t chunk) const
+{
+  std::string stem=GetOutputStem();
+  std::ostringstream name;
+  name << stem << "_" << std::setw(4) << std::setfill('0') << chunk << filename_output_.substr(stem.size());
+  return name.str();
+}
+
+// The index is Validation_index.txt
+std::string ValidationModule::GetIndexFileName() const
+{
+  return GetOutputStem()+"_index.txt";
+}
+
+// And the checkpoint is Validation_checkpoint.txt
+std::string ValidationModule::GetCheckpointFileName() const
+{
+  return GetOutputStem()+"_checkpoint.txt";
+}
+
+// Only start a new file once the current one has something in it
+bool ValidationModule::NeedsNewTreeFile()
+{
+  if (!IsRolling() || chunks_.back().entryCount_==0) return false;
+  if (rollEvents_>0 && chunks_.back().entryCount_>=rollEvents_) return true;
+  // Baskets are only compressed when they are flushed, so this grows a cluster at a time
+  Long64_t zipBytes=(asyncWriter_ ? treeWriter_.GetZipBytes() : tree_->GetZipBytes());
+  return (rollMegabytes_>0 && zipBytes>=rollMegabytes_*1e6);
+}
+
+// One line per file: its name, the job-wide entry number of its first event, its number of
+// events, and the run numbers in it (-1 for events without an event header)
+void ValidationModule::WriteIndex()
+{
+  std::ofstream index(GetIndexFileName().c_str());
+  if (!index)
+  {
+    std::cerr << "Could not write the output file index " << GetIndexFileName() << std::endl;
+    return;
+  }
+  index << "# file first_entry entries runs" << std::endl;
+  for (size_t i=0;i<chunks_.size();++i) WriteChunkLine(index,chunks_[i]);
+  std::cout << "Wrote the index of " << chunks_.size() << " output files to " << GetIndexFileName() << std::endl;
+}
+
+// Independent jobs can each do a slice of the same input: either shard shard_index of shard_count
+// equal slices of the input_event_count input events, or an explicit event_range of input events
+// (the first, and one past the last). The rest of the input events are skipped
+void ValidationModule::SetShards(const datatools::properties& myConfig)
+{
+  int inputEvents=0;
+  std::vector<int> eventRange;
+  try {
+    myConfig.fetch("shard_index",this->shardIndex_);
+  } catch (std::logic_error& e) {
+  }
+  try {
+    myConfig.fetch("shard_count",this->shardCount_);
+  } catch (std::logic_error& e) {
+  }
+  try {
+    myConfig.fetch("input_event_count",inputEvents);
+  } catch (std::logic_error& e) {
+  }
+  try {
+    myConfig.fetch("event_range",eventRange);
+  } catch (std::logic_error& e) {
+  }
+  DT_THROW_IF(shardCount_<0 || (shardCount_>0 && (shardIndex_<0 || shardIndex_>=shardCount_)),
+              std::logic_error,
+              "shard_index must be from 0 to shard_count-1");
+  DT_THROW_IF(shardCount_>0 && !eventRange.empty(),
+              std::logic_error,
+              "Give either shard_count or event_range, not both");
+  if (shardCount_>0)
+  {
+    DT_THROW_IF(inputEvents<=0,
+                std::logic_error,
+                "shard_count needs input_event_count, the number of events in the whole input");
+    Long64_t shardEvents=(inputEvents+shardCount_-1)/shardCount_;
+    firstEvent_=std::min<Long64_t>(shardIndex_*shardEvents,inputEvents);
+    endEvent_=std::min<Long64_t>(firstEvent_+shardEvents,inputEvents);
+  }
+  else if (!eventRange.empty())
+  {
+    DT_THROW_IF(eventRange.size()!=2 || eventRange[0]<0 || eventRange[1]<=eventRange[0],
+                std::logic_error,
+                "event_range must be the first input event and one past the last");
+    firstEvent_=eventRange[0];
+    endEvent_=eventRange[1];
+  }
+  else return;
+  // Each shard gets its own output name, and so its own rolling files, index and checkpoint
+  std::string stem=GetOutputStem();
+  std::ostringstream name;
+  if (shardCount_>0) name << stem << "_shard" << std::setw(4) << std::setfill('0') << shardIndex_ << "of" << std::setw(4) << shardCount_;
+  else name << stem << "_events" << firstEvent_ << "-" << endEvent_;
+  name << filename_output_.substr(stem.size());
+  filename_output_=name.str();
+  std::cout << "Validating input events " << firstEvent_ << " to " << endEvent_-1 << " into " << filename_output_ << std::endl;
+}
+
+bool ValidationModule::IsSharded() const
+{
+  return (endEvent_>=0);
+}
+
+// Input events are numbered from 0
+bool ValidationModule::IsInEventRange(Long64_t inputEvent) const
+{
+  return (inputEvent>=firstEvent_ && (endEvent_<0 || inputEvent<endEvent_));
+}
+
+// A Shard tree with one entry saying which input events this output has, and how many Validation
+// entries they made, so that the merge tool can put the shards in order. Merging the shards
+// concatenates these, so the merged file has one entry per shard
+void ValidationModule::WriteShardInfo()
+{
+  hfile_->cd();
+  TTree *shardTree = new TTree("Shard","Input events in this output");
+  shardTree->SetDirectory(hfile_);
+  int shardIndex=shardIndex_;
+  int shardCount=shardCount_;
+  Long64_t firstEvent=firstEvent_;
+  Long64_t endEvent=std::max(firstEvent_,std::min(endEvent_,inputEventCount_)); // In case the input ran out first
+  Long64_t entries=entryCount_;
+  shardTree->Branch("shard_index",&shardIndex);
+  shardTree->Branch("shard_count",&shardCount);
+  shardTree->Branch("first_event",&firstEvent);
+  shardTree->Branch("end_event",&endEvent);
+  shardTree->Branch("entries",&entries);
+  shardTree->Fill();
+  hfile_->WriteTObject(shardTree,nullptr,"Overwrite");
+  delete shardTree;
+  if (endEvent<endEvent_)
+  {
+    std::cerr << "The input ended at event " << inputEventCount_ << ", before the end of this shard (" << endEvent_ << ")" << std::endl;
+  }
+}
+
+// Save everything every checkpoint_events input events. With resume, carry on from the last
+// checkpoint of an earlier job with the same configuration, skipping the input events it had
+// already processed. If there is no checkpoint, the job starts from the beginning as usual
+void ValidationModule::SetCheckpoints(const datatools::properties& myConfig)
+{
+  try {
+    myConfig.fetch("checkpoint_events",this->checkpointEvents_);
+  } catch (std::logic_error& e) {
+  }
+  try {
+    myConfig.fetch("resume",this->resume_);
+  } catch (std::logic_error& e) {
+  }
+  DT_THROW_IF(checkpointEvents_<0,
+              std::logic_error,
+              "checkpoint_events can't be negative");
+  // The sample so far isn't saved, so it couldn't be carried on
+  DT_THROW_IF(resume_ && (detailFraction_<1 || detailReservoirSize_>0),
+              std::logic_error,
+              "Can't resume with detail sampling");
+  // Nor are the monitors' windows and the reference comparison's histograms
+  DT_THROW_IF(resume_ && (monitorChannels_ || !referenceFile_.empty()),
+              std::logic_error,
+              "Can't resume with monitor_channels or reference_file");
+  inputEventCount_=0;
+  skipEvents_=0;
+  entryCount_=0;
+  if (resume_ && !ReadCheckpoint())
+  {
+    std::cout << "No checkpoint in " << GetCheckpointFileName() << ": starting from the beginning" << std::endl;
+    resume_=false;
+  }
+  nextCheckpoint_=skipEvents_+checkpointEvents_;
+}
+
+// The checkpoint file has a header line with the number of input events processed and Validation
+// tree entries written, and the number of rolling output files, followed by the files as in the index
+bool ValidationModule::ReadCheckpoint()
+{
+  std::ifstream input(GetCheckpointFileName().c_str());
+  if (!input) return false;
+  std::string line, label;
+  size_t chunkCount=0;
+  std::getline(input,line);
+  std::istringstream header(line);
+  if (!(header >> label >> skipEvents_ >> entryCount_ >> chunkCount) || label!="ValidationCheckpoint")
+  {
+    std::cerr << "Could not read the checkpoint " << GetCheckpointFileName() << std::endl;
+    skipEvents_=0;
+    entryCount_=0;
+    return false;
+  }
+  chunks_.clear();
+  while (chunks_.size()<chunkCount && std::getline(input,line))
+  {
+    OutputChunk chunk;
+    if (ReadChunkLine(line,chunk)) chunks_.push_back(chunk);
+  }
+  DT_THROW_IF(chunks_.size()!=chunkCount || IsRolling()!=(chunkCount>0),
+              std::logic_error,
+              "The checkpoint " << GetCheckpointFileName() << " doesn't match the rolling output configuration");
+  std::cout << "Resuming from the checkpoint after " << skipEvents_ << " input events" << std::endl;
+  return true;
+}
+
+// Save the tree and everything accumulated so far, then record how far we got. The record is
+// written last, and replaced in one go, so it never claims more than is safely in the files
+void ValidationModule::WriteCheckpoint()
+{
+  if (tree_)
+  {
+    treeWriter_.Wait(); // The writer leaves the tree alone until the next event is pushed
+    treeFile_->cd();
+    tree_->AutoSave("SaveSelf;FlushBaskets");
+  }
+  hfile_->cd();
+  if (histogramOnly_ || !histogramConfig_.empty()) histograms_.WriteCheckpoint(hfile_);
+  accumulators_.Write(hfile_);
+  WriteTopologyEntries();
+  hfile_->SaveSelf(true);
+  hfile_->Flush();
+  if (treeFile_ && treeFile_!=hfile_) treeFile_->Flush();
+
+  std::string temporaryName=GetCheckpointFileName()+".tmp";
+  {
+    std::ofstream output(temporaryName.c_str());
+    output << "ValidationCheckpoint " << inputEventCount_ << " " << entryCount_ << " " << chunks_.size() << std::endl;
+    for (size_t i=0;i<chunks_.size();++i) WriteChunkLine(output,chunks_[i]);
+    if (!output)
+    {
+      std::cerr << "Could not write the checkpoint " << temporaryName << std::endl;
+      return;
+    }
+  }
+  if (std::rename(temporaryName.c_str(),GetCheckpointFileName().c_str())!=0)
+  {
+    std::cerr << "Could not replace the checkpoint " << GetCheckpointFileName() << std::endl;
   }
-  return;
 }
 
+// Keep the memory the module holds (tree baskets, event buffers and accumulators) under
+// memory_budget_mb megabytes, as far as possible. The peak is reported either way
+void ValidationModule::SetMemoryBudget(const datatools::properties& myConfig)
+{
+  try {
+    myConfig.fetch("memory_budget_mb",this->memoryBudgetMB_);
+  } catch (std::logic_error& e) {
+  }
+  DT_THROW_IF(memoryBudgetMB_<0,
+              std::logic_error,
+              "memory_budget_mb can't be negative");
+  peakMemory_=MemoryUsage();
+  memoryWarned_=false;
+}
+
+MemoryUsage ValidationModule::GetMemoryUsage()
+{
+  MemoryUsage usage;
+  if (tree_) usage.baskets_=(asyncWriter_ ? treeWriter_.GetBasketBytes() : GetTreeBasketBytes(tree_));
+  // The writer's buffers aren't ours to look at while it runs, so assume they are like this one
+  size_t eventBytes=GetEventStorageBytes(validation_);
+  usage.events_=eventBytes;
+  if (asyncWriter_) usage.events_+=(treeWriter_.GetBufferCount()+1)*eventBytes;
+  for (size_t i=0;i<reservoir_.size();++i) usage.events_+=GetEventStorageBytes(reservoir_[i]);
+  usage.accumulators_=accumulators_.GetMemoryBytes()+histograms_.GetMemoryBytes();
+  return usage;
+}
+
+// The accumulators can't give anything back, so the event buffers are shrunk first, and the
+// baskets get whatever is left
+void ValidationModule::CheckMemory()
+{
+  MemoryUsage usage=GetMemoryUsage();
+  Long64_t budget=(Long64_t)(memoryBudgetMB_*1e6);
+  if (budget>0)
+  {
+    if (usage.GetTotal()>budget)
+    {
+      ShrinkEventStorage(validation_);
+      usage=GetMemoryUsage();
+    }
+    // Never squeeze the baskets below a tenth of the budget: they would be flushed every few events
+    Long64_t basketBytes=std::max(budget-usage.events_-usage.accumulators_,budget/10);
+    if (asyncWriter_) treeWriter_.SetBasketLimit(basketBytes);
+    else if (tree_ && LimitTreeBaskets(tree_,basketBytes)) usage=GetMemoryUsage();
+    if (usage.GetTotal()>budget && !memoryWarned_)
+    {
+      std::cerr << "The module needs about " << usage.GetTotal()/1e6 << " MB, more than memory_budget_mb, even after shrinking its buffers" << std::endl;
+      memoryWarned_=true;
+    }
+  }
+  if (usage.GetTotal()>peakMemory_.GetTotal()) peakMemory_=usage;
+}
+
+void ValidationModule::ReportMemory()
+{
+  std::cout << "Peak estimated memory: " << peakMemory_.GetTotal()/1e6 << " MB (tree baskets " << peakMemory_.baskets_/1e6
+            << " MB, event buffers " << peakMemory_.events_/1e6 << " MB, accumulators " << peakMemory_.accumulators_/1e6 << " MB)";
+  if (memoryBudgetMB_>0) std::cout << " with a budget of " << memoryBudgetMB_ << " MB";
+  std::cout << std::endl;
+}
+
+// Decide whether this event keeps its details, and clear them from the main tree if not.
+// For the reservoir, the details are never in the main tree
+void ValidationModule::SampleDetail()
+{
+  Long64_t entry=entryCount_; // The entry this event is about to be
+  if (detailReservoirSize_>0)
+  {
+    // The first events fill the reservoir. After that, event n replaces a random member
+    // with probability size/(n+1), so every event is equally likely to be in the final sample
+    if ((int)reservoir_.size()<detailReservoirSize_)
+    {
+      reservoir_.push_back(validation_);
+      reservoirEntries_.push_back(entry);
+    }
+    else
+    {
+      Long64_t slot=(Long64_t)(detailRandom_.Rndm()*(entry+1));
+      if (slot<detailReservoirSize_)
+      {
+        reservoir_[slot]=validation_;
+        reservoirEntries_[slot]=entry;
+      }
+    }
+    ClearDetail(validation_);
+    return;
+  }
+  validation_.detail_sampled_=(detailRandom_.Rndm()<detailFraction_);
+  if (validation_.detail_sampled_) detailEntries_->Enter(entry);
+  else ClearDetail(validation_);
+}
+
+// Write the reservoir to the ValidationDetail tree, in Validation tree order, with the entry
+// number of each event in the entry branch so it can be joined back, and write the entry list
+void ValidationModule::WriteDetail()
+{
+  if (detailReservoirSize_>0)
+  {
+    std::vector<size_t> order(reservoir_.size());
+    for (size_t i=0;i<order.size();++i) order[i]=i;
+    std::sort(order.begin(),order.end(),[this](size_t a, size_t b){return reservoirEntries_[a]<reservoirEntries_[b];});
+    hfile_->cd();
+    TTree *detailTree = new TTree("ValidationDetail","Validation details for a sample of events");
+    detailTree->SetDirectory(hfile_);
+    ValidationEventStorage detail=validation_; // Has the band maps sized already
+    Long64_t entry;
+    detailTree->Branch("entry",&entry);
+    BookBranches(detailTree,detail,true,true,false);
+    outputProfile_.Apply(detailTree);
+    for (size_t i=0;i<order.size();++i)
+    {
+      entry=reservoirEntries_[order[i]];
+      detail=reservoir_[order[i]]; // Same sizes for the band maps, so the branch addresses don't move
+      detailTree->Fill();
+      detailEntries_->Enter(entry);
+    }
+    detailTree->Write();
+    delete detailTree;
+    reservoir_.clear();
+    reservoirEntries_.clear();
+  }
+  hfile_->WriteTObject(detailEntries_);
+  delete detailEntries_;
+  detailEntries_=nullptr;
+}
+
+// An entry list for each event topology, named topology_<name>. With rolling output the entry
+// numbers are job-wide, as for detail_entries. With resume, carry on from the checkpointed lists
+void ValidationModule::OpenTopologyEntries(bool resume)
+{
+  for (int topology=0;topology<TOPOLOGY_COUNT;++topology)
+  {
+    std::string name=std::string("topology_")+TOPOLOGY_NAMES[topology];
+    std::string title=std::string("Validation entries with the ")+TOPOLOGY_NAMES[topology]+" topology";
+    TEntryList *entries;
+    if (IsRolling()) entries = new TEntryList(name.c_str(),title.c_str());
+    else entries = new TEntryList(name.c_str(),title.c_str(),tree_);
+    if (resume)
+    {
+      TEntryList *checkpointed=nullptr;
+      hfile_->GetObject(name.c_str(),checkpointed);
+      DT_THROW_IF(!checkpointed,
+                  std::logic_error,
+                  "Can't resume: the checkpointed " << name << " entry list is missing from " << filename_output_);
+      for (Long64_t i=0;i<checkpointed->GetN();++i) entries->Enter(checkpointed->GetEntry((int)i));
+      delete checkpointed;
+    }
+    topologyEntries_.push_back(entries);
+  }
+}
+
+// Replaces the lists from the last checkpoint, if there was one
+void ValidationModule::WriteTopologyEntries()
+{
+  for (TEntryList *entries : topologyEntries_) hfile_->WriteTObject(entries,nullptr,"Overwrite");
+}
+
+// Band number for this energy: a hit exactly on an edge goes in the higher band
+size_t ValidationModule::GetCaloEnergyBand(double energy) const
+{
+  return std::upper_bound(caloBandEdges_.begin(),caloBandEdges_.end(),energy)-caloBandEdges_.begin();
+}
+
+int ValidationModule::EncodeLocation(const snemo::datamodel::calibrated_tracker_hit & hit) const
+{
+  // Negative numbers are Italy side, positive are France side
+  // layers are 0 to 8 with 0 being at the source foil and 8 by the main wall
+  // rows go from 0 (mountain) to 112 (tunnel)
+  // Decode it with the functions in TrackerLocation.h
+  return TrackerEncode(hit.get_side(), hit.get_layer(), hit.get_row());
+}
+
+// For each hit in the particle's cluster, compare the drift radius with how far the fitted
+// trajectory passes from the wire. The wire positions come from the table, not the geometry
+void ValidationModule::AddTrackResiduals(TrackBatch &trackBatch, size_t iParticle, ValidationEventStorage &event) const
+{
+  if (!trackerCells_.IsFilled() || !trackBatch.HasFlag(iParticle,TrackBatch::HAS_TRAJECTORY)) return;
+  const snemo::datamodel::calibrated_data::tracker_hit_collection_type & hits = trackBatch.GetTrack(iParticle).get_trajectory().get_cluster().get_hits();
+  for (snemo::datamodel::calibrated_data::tracker_hit_collection_type::const_iterator iHit = hits.begin(); iHit != hits.end(); ++iHit)
+  {
+    const snemo::datamodel::calibrated_tracker_hit & hit = iHit->get();
+    int location=EncodeLocation(hit);
+    double x, y;
+    if (!trackerCells_.GetPosition(location,x,y)) continue;
+    double distance=trackBatch.GetDistanceFromTrajectory(iParticle,x,y);
+    event.t_track_cell_hit_map_.push_back(location);
+    event.tm_track_drift_radius_.push_back(hit.get_r());
+    event.tm_trajectory_distance_.push_back(distance);
+    event.tm_drift_radius_residual_.push_back(distance-hit.get_r());
+    event.v_track_cell_x_.push_back(x);
+    event.v_track_cell_y_.push_back(y);
+  }
+}
+
+
+int ValidationModule::EncodeLocation(const snemo::datamodel::calibrated_calorimeter_hit & hit) const
+{
+  // Side, wall, column and row packed into an int in the same way as the tracker locations
+  // Decode it with the functions in CaloLocation.h
+  return EncodeCaloLocation(hit);
+}
 
 //! [ValidationModule::reset]
 void ValidationModule::reset() {
+  CheckMemory(); // For the peak
+  ReportMemory();
+  if (tree_) CloseTreeFile();
+  if (IsRolling()) WriteIndex();
   hfile_->cd();
-  tree_->Write();
+  if (histogramOnly_ || !histogramConfig_.empty()) histograms_.Write(hfile_);
+  histograms_.Clear();
+  if (detailEntries_) WriteDetail();
+  WriteTopologyEntries();
+  for (TEntryList *entries : topologyEntries_) delete entries;
+  topologyEntries_.clear();
+  accumulators_.Write(hfile_);
+  if (!referenceFile_.empty())
+  {
+    referenceComparator_.Compare(); // Include the events since the last check
+    referenceComparator_.Write(hfile_);
+    referenceComparator_.Clear();
+  }
+  if (monitorChannels_)
+  {
+    trackerMonitor_.Finish();
+    caloMonitor_.Finish();
+    ChannelRateMonitor::Write(hfile_,{&trackerMonitor_,&caloMonitor_});
+  }
+  if (IsSharded()) WriteShardInfo();
   hfile_->Close(); //
+  // Everything is written, so there is nothing to resume from
+  if (checkpointEvents_>0 || resume_) std::remove(GetCheckpointFileName().c_str());
   std::cout << "In reset: finished conversion, file closed " << std::endl;
 
   // clean up
   delete hfile_;
   filename_output_ = "Validation.root";
+  caloStringIds_=false;
+  accumulateMaps_=false;
+  writeHitVectors_=true;
+  quantileSketches_=true;
+  sketchAccuracy_=0.01;
+  runSummary_=true;
+  timeBucketSeconds_=3600;
+  topologyEntryLists_=true;
+  monitorChannels_=false;
+  detailFraction_=1;
+  detailReservoirSize_=0;
+  detailSeed_=1;
+  histogramOnly_=false;
+  histogramConfig_="";
+  histogramWarmup_=1000;
+  referenceFile_="";
+  referenceStopOnAlarm_=false;
+  asyncWriter_=false;
+  asyncQueueSize_=64;
+  entryCount_=0;
+  fillSeconds_=0;
+  rollEvents_=0;
+  rollMegabytes_=0;
+  chunks_.clear();
+  checkpointEvents_=0;
+  resume_=false;
+  inputEventCount_=0;
+  skipEvents_=0;
+  nextCheckpoint_=0;
+  memoryBudgetMB_=0;
+  memoryWarned_=false;
+  shardIndex_=0;
+  shardCount_=0;
+  firstEvent_=0;
+  endEvent_=-1;
+  if (implicitMTEnabled_) ROOT::DisableImplicitMT();
+  implicitMTEnabled_=false;
+  outputProfile_=OutputProfile();
+  tree_=nullptr;
+  caloPositions_.Clear();
+  trackerCells_.Clear();
   this->_set_initialized(false);
 
 }
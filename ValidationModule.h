@@ -11,6 +11,9 @@
 #include "TMath.h"
 #include "TF1.h"
 #include "TVector3.h"
+#include "TEntryList.h"
+#include "TRandom3.h"
+#include "TROOT.h"
 
 // - Bayeux
 #include "bayeux/dpp/base_module.h"
@@ -29,62 +32,35 @@
 #include "falaise/snemo/datamodels/tracker_clustering_data.h"
 #include "falaise/snemo/datamodels/tracker_clustering_solution.h"
 #include "falaise/snemo/datamodels/particle_track_data.h"
+#include "falaise/snemo/datamodels/event_header.h"
 
 //include module to get primary vertices
 #include "TrackDetails.h"
-
-
-typedef struct ValidationEventStorage{
-  // Quantities to histogram (h_)
-  double h_total_calorimeter_energy_;
-  double h_calo_energy_over_threshold_; // 50keV threshold to remove noise
-  double h_calo_hit_time_separation_; // Between the first and last calo hits
-  int h_calorimeter_hit_count_; // How many calorimeter hits?
-  int h_calo_hits_over_threshold_; // How many calorimeter hits over threshold?
-  int h_cluster_count_; // How many clusters with 3 or more hits?
-  int h_track_count_; // How many reconstructed tracks?
-  int h_negative_track_count_; // How many reconstructed tracks with negative curvature?
-  int h_positive_track_count_; // How many reconstructed tracks with positive curvature?
-  int h_associated_track_count_; // How many reconstructed tracks with an associated calorimeter?
-  int h_geiger_hit_count_; // How many reconstructed tracker hits?
-  double h_unassociated_calorimeter_energy_; // Summed calorimeter energy not associated to any track (in MeV)
-  double h_unassociated_energy_over_threshold_; // Threshold is 50 keV
-  double h_associated_calorimeter_energy_; // Summed calorimeter energy associated to any track (in MeV)
-  double h_associated_energy_over_threshold_; // Threshold is 50 keV
-
-
-  // For vector (v_) quantities you can have more than 1 entry per event
-  // NOT implemented yet!
-  std::vector<int> v_all_track_hit_counts_; // Vector of how many hits for ALL tracks (delayed or not)
-
-  // For tracker maps: some values want to be summed over all events (t_), and some to be averaged (tm_)
-  // All tm variables will need to be paired with a hit map, so that we can match the vector of values
-  // to a vector of locations. This pairing must be defined in the config file.
-
-  std::vector<int> t_cell_hit_count_; // map of cells that have been hit
-  std::vector<double> tm_average_drift_radius_; // map of cells that have been hit
-  // For calorimeter maps : some values want to be summed over all events (c_), and some to be averaged (cm_)
-  // All cm variables will need to be paired with a hit map, so that we can match the vector of values
-  // to a vector of locations. This pairing must be defined in the config file.
-  std::vector<std::string> c_calorimeter_hit_map_;
-
-  //
-  std::vector<std::string> c_calorimeter_hit_map_low_;
-  std::vector<std::string> c_calorimeter_hit_map_med_;
-  std::vector<std::string> c_calorimeter_hit_map_high_;
-  std::vector<std::string> c_calorimeter_hit_map_backscatter_;
-  //
-
-  std::vector<double> cm_average_calorimeter_energy_;
-
-//changes
-std::vector<double> electron_vertex_x_;
-std::vector<double> electron_vertex_y_;
-std::vector<double> electron_vertex_z_;
-std::vector<std::string> track_calo_hits_;
-
-}Validationeventstorage;
-
+#include "OrderedParticleTable.h"
+#include "CaloPositionTable.h"
+#include "TrackerCellTable.h"
+#include "ValidationEventStorage.h"
+#include "ValidationAccumulators.h"
+#include "ChannelRateMonitor.h"
+#include "HistogramBook.h"
+#include "ReferenceComparator.h"
+#include "AsyncTreeWriter.h"
+#include "OutputProfile.h"
+#include "MemoryBudget.h"
+#include "EventTopology.h"
+
+#include <set>
+
+
+
+
+// One of the files of Validation tree entries, with rolling output
+struct OutputChunk{
+  std::string fileName_;
+  Long64_t firstEntry_=0; // Job-wide entry number of its first event
+  Long64_t entryCount_=0;
+  std::set<int> runs_;
+};
 
 // This Project
 class ValidationModule : public dpp::base_module {
@@ -102,25 +78,134 @@ class ValidationModule : public dpp::base_module {
   virtual dpp::base_module::process_status process(datatools::things& workItem);
   //! Reset the module
   virtual void reset();
+
+  // process() in steps, so that events can be built in parallel and then recorded in order
+  // (see ValidationDriver). Call StartEvent for every input event: if it returns false, the
+  // event is skipped. Otherwise build it and, if that returns PROCESS_OK, record it
+  bool StartEvent();
+  dpp::base_module::process_status BuildEvent(const datatools::things& workItem, ValidationEventStorage &event,
+                                              OrderedParticleTable &electronTable, TrackBatch &trackBatch) const;
+  dpp::base_module::process_status RecordEvent(ValidationEventStorage &event);
+  // Size the calorimeter band maps of an event storage to match the module's
+  void InitializeEventStorage(ValidationEventStorage &event) const;
+  Long64_t GetSkipEvents() const; // Input events that will be skipped when resuming, or before the shard's range
+  Long64_t GetEndEvent() const; // One past the shard's last input event, or -1 if it goes to the end of the input
  private:
   TFile* hfile_;
+  TFile* treeFile_; // The file the Validation tree is in: hfile_, unless the output is rolling
   TTree* tree_;
   ValidationEventStorage validation_;
+  ValidationEventStorage treeStorage_; // With async_writer, the tree's branches point here instead of at validation_
+  AsyncTreeWriter treeWriter_;
+  Long64_t entryCount_; // Events passed to the Validation tree so far, filled or still queued
+  OrderedParticleTable electronTable_; // Reused every event
+  TrackBatch trackBatch_; // Reused every event
+  CaloPositionTable caloPositions_; // Calorimeter block positions, filled at initialize
+  TrackerCellTable trackerCells_; // Tracker wire positions, filled at initialize
+  ValidationAccumulators accumulators_; // Whole-job maps and sketches
+  ChannelRateMonitor trackerMonitor_; // Hot and dead channels, if monitorChannels_ is set
+  ChannelRateMonitor caloMonitor_;
+  HistogramBook histograms_; // Only filled with histogramOnly_ or a histogramConfig_
+  ReferenceComparator referenceComparator_;
+  // Sampled detail
+  TRandom3 detailRandom_;
+  TEntryList* detailEntries_; // Entries in the Validation tree that have (or, for the reservoir, are in the detail tree with) details
+  std::vector<ValidationEventStorage> reservoir_;
+  std::vector<Long64_t> reservoirEntries_; // Validation tree entry of each event in reservoir_
+  std::vector<TEntryList*> topologyEntries_; // With topologyEntryLists_, one per topology bit in EventTopology.h
 
   // configurable data member
   std::string filename_output_;
+  bool caloStringIds_; // Write calorimeter locations as strings instead of integers
+  std::vector<double> caloBandEdges_; // Energies (MeV) separating the calorimeter map energy bands, in increasing order
+  std::vector<std::string> caloBandNames_; // One more of these than there are edges
+  std::string caloPositionFile_; // Load the calorimeter positions from here if possible, otherwise save them here
+  bool accumulateMaps_; // Sum the tracker and calorimeter maps in the module and write them at the end
+  bool writeHitVectors_; // Write the per-hit map vectors to the tree for every event
+  bool quantileSketches_; // Keep a quantile sketch of each h_ quantity
+  double sketchAccuracy_; // Relative accuracy of the sketch quantiles
+  bool runSummary_; // Keep the totals of the h_ quantities for each run
+  int timeBucketSeconds_; // And for each time bucket this long, if more than 0
+  bool topologyEntryLists_; // Write an entry list of the Validation entries for each event topology
+  bool monitorChannels_; // Look for hot and dead tracker cells and calorimeter blocks as we go
+  RateMonitorSettings monitorSettings_;
+  double detailFraction_; // Fraction of events that keep their per-hit and per-electron branches
+  int detailReservoirSize_; // Or, if this is set, keep them for a uniform sample of this many events
+  int detailSeed_;
+  bool histogramOnly_; // Fill the h_ histograms and don't write the Validation tree at all
+  std::string histogramConfig_; // Binning for the h_ histograms, in the ValidateReconstruction.conf format
+  int histogramWarmup_; // Events to buffer before choosing the range of a histogram with no binning
+  std::string referenceFile_; // Compare the distributions with the ones in this file, if it is set
+  bool referenceStopOnAlarm_; // Stop processing when a distribution diverges from the reference
+  bool asyncWriter_; // Fill the Validation tree on a separate thread
+  int asyncQueueSize_; // Events that can be waiting for the writer thread
+  OutputProfile outputProfile_; // Compression, basket sizes and flush cadence of the output
+  bool implicitMTEnabled_; // The output profile turned on ROOT's implicit multithreading, so reset turns it off
+  double fillSeconds_; // Time spent filling the Validation tree in this thread, for the write speed
+  int rollEvents_; // Start a new file of Validation tree entries after this many events, if more than 0
+  double rollMegabytes_; // Or after this many compressed megabytes
+  std::vector<OutputChunk> chunks_; // The files written so far, with rolling output; the last one is open
+  int checkpointEvents_; // Save everything every this many input events, if more than 0
+  bool resume_; // Carry on from the last checkpoint, if there is one
+  Long64_t inputEventCount_; // Events passed to process() so far, including skipped ones
+  Long64_t skipEvents_; // Input events that were already processed before the checkpoint we resumed from
+  Long64_t nextCheckpoint_;
+  double memoryBudgetMB_; // Keep the module's estimated memory below this, if more than 0
+  MemoryUsage peakMemory_; // The largest estimate so far
+  bool memoryWarned_; // Have we said that the budget is too small?
+  int shardIndex_; // This job's shard, if shardCount_ is more than 0
+  int shardCount_;
+  Long64_t firstEvent_; // Only process input events from firstEvent_ up to (not including) endEvent_
+  Long64_t endEvent_; // -1 for the end of the input
 
   // geometry service
   const geomtools::manager* geometry_manager_; //!< The geometry manager
 
-  void ResetVars();
+  static void ResetVars(ValidationEventStorage &event);
+  dpp::base_module::process_status RecordCurrentEvent();
+  void InitializeAccumulators(ValidationAccumulators &accumulators) const;
+  void BookBranches(TTree *tree, ValidationEventStorage &storage, bool hitVectors, bool electronDetails, bool existing);
+  static void ClearDetail(ValidationEventStorage &storage);
+  void SetDetailSampling(const datatools::properties& myConfig);
+  void SetHistograms(const datatools::properties& myConfig);
+  void SetReference(const datatools::properties& myConfig);
+  void SetAsyncWriter(const datatools::properties& myConfig);
+  void SetOutputProfile(const datatools::properties& myConfig);
+  void ReportOutput(double writeSeconds);
+  void SetRollingOutput(const datatools::properties& myConfig);
+  bool IsRolling() const;
+  std::string GetOutputStem() const;
+  std::string GetChunkFileName(size_t chunk) const;
+  std::string GetIndexFileName() const;
+  std::string GetCheckpointFileName() const;
+  void SetShards(const datatools::properties& myConfig);
+  bool IsSharded() const;
+  bool IsInEventRange(Long64_t inputEvent) const;
+  void WriteShardInfo();
+  void SetCheckpoints(const datatools::properties& myConfig);
+  bool ReadCheckpoint();
+  void WriteCheckpoint();
+  void SetMemoryBudget(const datatools::properties& myConfig);
+  MemoryUsage GetMemoryUsage();
+  void CheckMemory();
+  void ReportMemory();
+  void OpenTreeFile(bool resume);
+  void CloseTreeFile();
+  bool NeedsNewTreeFile();
+  void WriteIndex();
+  void FillTree();
+  void SampleDetail();
+  void WriteDetail();
+  void OpenTopologyEntries(bool resume);
+  void WriteTopologyEntries();
+  void SetCaloEnergyBands(const datatools::properties& myConfig);
+  size_t GetCaloEnergyBand(double energy) const;
+  void SetCaloPositions(const datatools::properties& myConfig);
+  void SetChannelMonitors(const datatools::properties& myConfig);
   // You need to include these functions if you want to make detector maps
-  int EncodeLocation(const snemo::datamodel::calibrated_tracker_hit & hit);
-  std::string EncodeLocation(const snemo::datamodel::calibrated_calorimeter_hit & hit);
-
-//added functions
-  int InsertAndGetPosition(double toInsert, std::vector<double> &vec, bool highestFirst);
-  template <typename T>  void InsertAt(T toInsert, std::vector<T> &vec, int position);
+  int EncodeLocation(const snemo::datamodel::calibrated_tracker_hit & hit) const;
+  int EncodeLocation(const snemo::datamodel::calibrated_calorimeter_hit & hit) const;
+  void AddTrackResiduals(TrackBatch &trackBatch, size_t iParticle, ValidationEventStorage &event) const;
 
   // Macro which automatically creates the interface needed
   // to enable the module to be loaded at runtime
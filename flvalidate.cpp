@@ -0,0 +1,262 @@
+// flvalidate: run the ValidationModule over reconstructed brio files on several threads.
+// It takes the module's section from the same pipeline script flreconstruct would use, and
+// the geometry of the same experimental setup, so the output is the same as
+//   flreconstruct -i file.brio -p ValidationModuleExample.conf
+// but with the events built in parallel (testValidationModule_flvalidate_compare checks this).
+// Run without arguments for the options
+#include "TROOT.h"
+
+// - Bayeux
+#include "bayeux/datatools/kernel.h"
+#include "bayeux/datatools/multi_properties.h"
+#include "bayeux/datatools/properties.h"
+#include "bayeux/datatools/service_manager.h"
+#include "bayeux/datatools/urn_info.h"
+#include "bayeux/datatools/urn_query_service.h"
+#include "bayeux/datatools/utils.h"
+#include "bayeux/dpp/base_module.h"
+
+// - Falaise
+#include "falaise/falaise.h"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ValidationModule.h"
+#include "ValidationDriver.h"
+#include "ValidationAggregate.h"
+#include "ValidationCache.h"
+
+namespace {
+const char *DEFAULT_SETUP_URN="urn:snemo:demonstrator:setup:1.0";
+
+void Usage()
+{
+  std::cerr<<"Usage: flvalidate -p pipeline.conf [options] input.brio [input.brio ...]"<<std::endl
+           <<"  -p FILE     pipeline script with a ValidationModule section"<<std::endl
+           <<"  -s NAME     the section to use, if there is more than one ValidationModule"<<std::endl
+           <<"  -u URN      experimental setup, for its geometry (default: "<<DEFAULT_SETUP_URN<<", as flreconstruct)"<<std::endl
+           <<"  -g FILE     geometry manager configuration, instead of the setup's"<<std::endl
+           <<"  -o FILE     output file, instead of the section's filename_out"<<std::endl
+           <<"  -t N        worker threads (default: one per core)"<<std::endl
+           <<"  -q N        events in flight between reading and recording (default: 4 per worker)"<<std::endl
+           <<"  -n N        stop after N input events"<<std::endl
+           <<"  -c DIR      keep an output per input file in DIR, and only process the files that aren't there"<<std::endl;
+}
+
+// The properties of the pipeline's ValidationModule section
+bool ReadModuleConfig(const std::string &pipelineFile, const std::string &sectionName, datatools::properties &config)
+{
+  std::string path=pipelineFile;
+  datatools::fetch_path_with_env(path);
+  datatools::multi_properties pipeline("name","type");
+  pipeline.read(path);
+  bool found=false;
+  for (const datatools::multi_properties::entry *section : pipeline.ordered_entries())
+  {
+    if (section->get_meta()!="ValidationModule") continue;
+    if (!sectionName.empty() && section->get_key()!=sectionName) continue;
+    if (found)
+    {
+      std::cerr<<"flvalidate: "<<pipelineFile<<" has more than one ValidationModule section, choose one with -s"<<std::endl;
+      return false;
+    }
+    config=section->get_properties();
+    found=true;
+  }
+  if (!found) std::cerr<<"flvalidate: no ValidationModule section"<<(sectionName.empty() ? "" : " called "+sectionName)
+                       <<" in "<<pipelineFile<<std::endl;
+  return found;
+}
+
+// The geometry manager configuration of an experimental setup, found the way flsimulate and
+// flreconstruct find it: the setup's geometry component, resolved to its configuration file
+std::string GetSetupGeometryFile(const std::string &setupUrn)
+{
+  const datatools::urn_query_service &urnQuery=datatools::kernel::instance().get_urn_query();
+  if (!urnQuery.check_urn_info(setupUrn, "expsetup"))
+  {
+    std::cerr<<"flvalidate: "<<setupUrn<<" isn't a known experimental setup"<<std::endl;
+    return "";
+  }
+  const datatools::urn_info &setupInfo=urnQuery.get_urn_info(setupUrn);
+  if (!setupInfo.has_topic("geometry"))
+  {
+    std::cerr<<"flvalidate: the experimental setup "<<setupUrn<<" has no geometry"<<std::endl;
+    return "";
+  }
+  std::string geometryUrn=setupInfo.get_component("geometry");
+  std::string category="configuration";
+  std::string mime;
+  std::string path;
+  if (!urnQuery.resolve_urn_to_path(geometryUrn, category, mime, path))
+  {
+    std::cerr<<"flvalidate: could not find the configuration of the geometry "<<geometryUrn<<std::endl;
+    return "";
+  }
+  return path;
+}
+
+void SetOutputFile(datatools::properties &config, const std::string &outputFile)
+{
+  if (config.has_key("filename_out")) config.update("filename_out", outputFile);
+  else config.store("filename_out", outputFile);
+}
+
+// Run a module over the inputs, writing to its filename_out. Returns false if it was stopped
+bool Validate(const datatools::properties &config, datatools::service_manager &services,
+              const std::vector<std::string> &inputFiles, int threads, int eventsInFlight, Long64_t maxEvents)
+{
+  ValidationModule module;
+  dpp::module_handle_dict_type modules;
+  module.initialize(config, services, modules);
+  ValidationDriver driver(module, threads, eventsInFlight);
+  std::clog<<"flvalidate: "<<inputFiles.size()<<" input file(s) on "<<threads<<" worker thread(s)"<<std::endl;
+  Long64_t eventsRead=driver.Run(inputFiles, maxEvents);
+  std::clog<<"flvalidate: "<<eventsRead<<" events read, "<<driver.GetErrorCount()<<" not recorded"<<std::endl;
+  // Writes the output, as at the end of an flreconstruct job
+  module.reset();
+  return !driver.WasStopped();
+}
+
+// Validate each input file on its own into the cache, unless it is there already from an earlier
+// run with the same content and configuration, then add the new outputs to the cache's running
+// totals. The output has the totals, and chains of the cached outputs' trees
+bool ValidateWithCache(datatools::properties config, datatools::service_manager &services,
+                       const std::vector<std::string> &inputFiles, const std::string &cacheDirectory,
+                       const std::string &geometryFile, int threads, int eventsInFlight)
+{
+  std::string outputFile=(config.has_key("filename_out") ? config.fetch_string("filename_out") : "Validation.root");
+  // The cached outputs are whole input files, chained as they are
+  for (const char *key : {"roll_events","roll_megabytes","shard_count","event_range"})
+  {
+    if (config.has_key(key))
+    {
+      std::cerr<<"flvalidate: "<<key<<" can't be used with a cache"<<std::endl;
+      return false;
+    }
+  }
+  // The key includes everything that changes the output, apart from where it goes
+  SetOutputFile(config, "");
+  std::ostringstream configText;
+  config.tree_dump(configText);
+  // The geometry file's content, so that an edited geometry makes new outputs too
+  uint64_t geometryHash=0;
+  if (!ValidationCache::HashFile(geometryFile, geometryHash))
+  {
+    std::cerr<<"flvalidate: could not read the geometry "<<geometryFile<<std::endl;
+    return false;
+  }
+  configText<<"geometry "<<ValidationCache::ToHex(geometryHash)<<std::endl;
+  ValidationCache cache(cacheDirectory, configText.str());
+  if (!cache.Open()) return false;
+  std::vector<std::string> keys;
+  std::vector<std::string> cachedFiles;
+  size_t reused=0;
+  for (const std::string &inputFile : inputFiles)
+  {
+    std::string key=cache.GetKey(inputFile);
+    if (key.empty()) return false;
+    if (cache.HasOutput(key)) ++reused;
+    else
+    {
+      SetOutputFile(config, cache.GetPartialFileName(key));
+      if (!Validate(config, services, {inputFile}, threads, eventsInFlight, 0) || !cache.Commit(key))
+      {
+        std::cerr<<"flvalidate: could not validate "<<inputFile<<" into the cache"<<std::endl;
+        cache.Save();
+        return false;
+      }
+      cache.Save(); // So that an interrupted job still has the hashes of the files it did
+    }
+    keys.push_back(key);
+    cachedFiles.push_back(cache.GetOutputFileName(key));
+  }
+  std::clog<<"flvalidate: "<<reused<<" of "<<inputFiles.size()<<" input file(s) unchanged"<<std::endl;
+  ValidationAggregate aggregate(cache.GetAggregateFileName());
+  if (!aggregate.Open() || !aggregate.Update(keys, cachedFiles) || !aggregate.Save()) return false;
+  std::clog<<"flvalidate: "<<aggregate.GetAddedCount()<<" cached output(s) added to the totals"<<std::endl;
+  return aggregate.WriteOutput(outputFile, cachedFiles);
+}
+}
+
+int main(int argc, char *argv[])
+{
+  std::string pipelineFile;
+  std::string sectionName;
+  std::string setupUrn=DEFAULT_SETUP_URN;
+  std::string geometryFile;
+  std::string outputFile;
+  int threads=(int)std::thread::hardware_concurrency();
+  int eventsInFlight=0;
+  Long64_t maxEvents=0;
+  std::string cacheDirectory;
+  std::vector<std::string> inputFiles;
+  for (int i=1;i<argc;i++)
+  {
+    std::string arg=argv[i];
+    bool hasValue=(i+1<argc);
+    if (arg=="-p" && hasValue) pipelineFile=argv[++i];
+    else if (arg=="-s" && hasValue) sectionName=argv[++i];
+    else if (arg=="-u" && hasValue) setupUrn=argv[++i];
+    else if (arg=="-g" && hasValue) geometryFile=argv[++i];
+    else if (arg=="-o" && hasValue) outputFile=argv[++i];
+    else if (arg=="-t" && hasValue) threads=std::atoi(argv[++i]);
+    else if (arg=="-q" && hasValue) eventsInFlight=std::atoi(argv[++i]);
+    else if (arg=="-n" && hasValue) maxEvents=std::atoll(argv[++i]);
+    else if (arg=="-c" && hasValue) cacheDirectory=argv[++i];
+    else if (arg=="-i" && hasValue) inputFiles.push_back(argv[++i]); // Like flreconstruct
+    else if (!arg.empty() && arg[0]!='-') inputFiles.push_back(arg);
+    else
+    {
+      Usage();
+      return EXIT_FAILURE;
+    }
+  }
+  // A cached output has to be for the whole file
+  if (pipelineFile.empty() || inputFiles.empty() || (!cacheDirectory.empty() && maxEvents>0))
+  {
+    Usage();
+    return EXIT_FAILURE;
+  }
+  if (threads<1) threads=1;
+
+  falaise::initialize(argc, argv);
+  // The reader, the workers and the tree writer all use ROOT at once
+  ROOT::EnableThreadSafety();
+  int result=EXIT_SUCCESS;
+  try
+  {
+    datatools::properties config;
+    if (!ReadModuleConfig(pipelineFile, sectionName, config)) throw std::logic_error("no module configuration");
+    if (!outputFile.empty()) SetOutputFile(config, outputFile);
+
+    // Without the geometry, the vertex and tracker cell quantities would be different from flreconstruct's
+    if (geometryFile.empty()) geometryFile=GetSetupGeometryFile(setupUrn);
+    if (geometryFile.empty()) throw std::logic_error("no geometry");
+    datatools::fetch_path_with_env(geometryFile);
+    datatools::service_manager services("flvalidate", "Services for flvalidate");
+    datatools::properties geometryConfig;
+    geometryConfig.store("manager.configuration_file", geometryFile);
+    services.load("geometry", "geomtools::geometry_service", geometryConfig);
+    services.initialize();
+
+    bool ok;
+    if (cacheDirectory.empty()) ok=Validate(config, services, inputFiles, threads, eventsInFlight, maxEvents);
+    else ok=ValidateWithCache(config, services, inputFiles, cacheDirectory, geometryFile, threads, eventsInFlight);
+    if (!ok) result=EXIT_FAILURE;
+    services.reset();
+  }
+  catch (std::exception &e)
+  {
+    std::cerr<<"flvalidate: "<<e.what()<<std::endl;
+    result=EXIT_FAILURE;
+  }
+  falaise::terminate();
+  return result;
+}
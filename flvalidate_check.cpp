@@ -0,0 +1,350 @@
+// flvalidate_check: check that a ValidationModule output is consistent with itself, for the tests
+// of the things flvalidate_compare can't check against another output:
+//   detail FILE K    the detail reservoir: ValidationDetail has K events (or all of them, if there
+//                    were fewer), in entry order; detail_entries lists the same entries; and their
+//                    h_ values are those of the same entries of the Validation tree
+//   histograms FILE REFERENCE CONFIG WARMUP
+//                    a histogram_only output: there is no Validation tree, and each h_ histogram has
+//                    the binning CONFIG gives it and the contents of the same quantity of REFERENCE's
+//                    Validation tree, auto-ranged over its first WARMUP entries where CONFIG has no range
+//   summary FILE QUANTITY
+//                    the RunSummary tree: its counts add up to the Validation tree's entries, and
+//                    QUANTITY's sums, minimum and maximum are those of the Validation tree
+//   topology FILE    each topology_<name> entry list has exactly the Validation entries whose
+//                    event_topology has that topology's bit
+// Run without arguments for the options
+#include "TBranch.h"
+#include "TEntryList.h"
+#include "TFile.h"
+#include "TH1D.h"
+#include "TTree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "EventTopology.h"
+#include "HistogramBook.h"
+
+namespace {
+const double RELATIVE_TOLERANCE=1e-9;
+
+void Usage()
+{
+  std::cerr<<"Usage: flvalidate_check CHECK output.root [arguments]"<<std::endl
+           <<"  detail output.root K     the detail reservoir has K events, matching detail_entries and the Validation tree"<<std::endl
+           <<"  histograms output.root reference.root config warmup"<<std::endl
+           <<"                           the histograms are those of the reference's Validation tree, binned as config says"<<std::endl
+           <<"  summary output.root QUANTITY"<<std::endl
+           <<"                           RunSummary's count, and QUANTITY's sums, minimum and maximum, match the Validation tree"<<std::endl
+           <<"  topology output.root      the topology entry lists select the entries with each event_topology bit"<<std::endl;
+}
+
+bool SameValue(double reference, double other)
+{
+  if (reference==other) return true;
+  return std::fabs(reference-other)<=RELATIVE_TOLERANCE*std::max(std::fabs(reference),std::fabs(other));
+}
+
+// The values of an expression for every entry, one after the other
+bool DrawValues(TTree *tree, const std::string &expression, std::vector<double> &values)
+{
+  values.clear();
+  tree->SetEstimate(tree->GetEntries()+1);
+  Long64_t rows=tree->Draw(expression.c_str(),"","goff");
+  if (rows<0) return false;
+  if (rows>0) values.assign(tree->GetV1(),tree->GetV1()+rows);
+  return true;
+}
+
+// The h_ branches, which have one value per entry
+std::vector<std::string> GetScalarBranches(TTree *tree)
+{
+  std::vector<std::string> names;
+  TIter next(tree->GetListOfBranches());
+  while (TBranch *branch=(TBranch*)next())
+  {
+    std::string name=branch->GetName();
+    if (name.compare(0,2,"h_")==0) names.push_back(name);
+  }
+  return names;
+}
+
+template<typename T> T* GetObject(TFile &file, const char *name)
+{
+  T *object=nullptr;
+  file.GetObject(name,object);
+  if (!object) std::cerr<<"flvalidate_check: "<<file.GetName()<<" has no "<<name<<std::endl;
+  return object;
+}
+
+bool CheckDetail(TFile &file, Long64_t sampleSize)
+{
+  TTree *tree=GetObject<TTree>(file,"Validation");
+  TTree *detail=GetObject<TTree>(file,"ValidationDetail");
+  TEntryList *detailEntries=GetObject<TEntryList>(file,"detail_entries");
+  if (!tree || !detail || !detailEntries) return false;
+  Long64_t expected=std::min(sampleSize,tree->GetEntries());
+  if (detail->GetEntries()!=expected)
+  {
+    std::cerr<<"ValidationDetail has "<<detail->GetEntries()<<" entries, not "<<expected<<std::endl;
+    return false;
+  }
+  std::vector<Long64_t> entries(expected);
+  Long64_t entry;
+  detail->SetBranchAddress("entry",&entry);
+  for (Long64_t i=0;i<expected;++i)
+  {
+    detail->GetEntry(i);
+    entries[i]=entry;
+    if (entry<0 || entry>=tree->GetEntries() || (i>0 && entry<=entries[i-1]))
+    {
+      std::cerr<<"ValidationDetail entry "<<i<<" is for Validation entry "<<entry<<", which is out of order or range"<<std::endl;
+      return false;
+    }
+  }
+  detail->ResetBranchAddresses();
+  if (detailEntries->GetN()!=expected)
+  {
+    std::cerr<<"detail_entries has "<<detailEntries->GetN()<<" entries, not "<<expected<<std::endl;
+    return false;
+  }
+  for (Long64_t i=0;i<expected;++i)
+  {
+    if (detailEntries->GetEntry((int)i)!=entries[i])
+    {
+      std::cerr<<"detail_entries entry "<<i<<" is "<<detailEntries->GetEntry((int)i)<<", but ValidationDetail has "<<entries[i]<<std::endl;
+      return false;
+    }
+  }
+  bool same=true;
+  for (const std::string &name : GetScalarBranches(tree))
+  {
+    std::vector<double> values, detailValues;
+    if (!DrawValues(tree,name,values) || !DrawValues(detail,name,detailValues)
+        || (Long64_t)values.size()!=tree->GetEntries() || (Long64_t)detailValues.size()!=expected)
+    {
+      std::cerr<<"Could not read "<<name<<" for every entry"<<std::endl;
+      same=false;
+      continue;
+    }
+    for (Long64_t i=0;i<expected;++i)
+    {
+      if (SameValue(values[entries[i]],detailValues[i])) continue;
+      std::cerr<<"ValidationDetail."<<name<<" is "<<detailValues[i]<<" for entry "<<entries[i]<<", but Validation has "
+               <<values[entries[i]]<<std::endl;
+      same=false;
+      break;
+    }
+  }
+  if (same) std::cout<<"flvalidate_check: "<<expected<<" of "<<tree->GetEntries()<<" entries have details"<<std::endl;
+  return same;
+}
+
+// Histograms the reference tree's values independently of the module, the way the config says,
+// and compares them bin by bin with the output's
+bool CheckHistograms(TFile &file, TFile &referenceFile, const std::string &configFile, int warmupEvents)
+{
+  TTree *notExpected=nullptr;
+  file.GetObject("Validation",notExpected);
+  if (notExpected)
+  {
+    std::cerr<<file.GetName()<<" has a Validation tree"<<std::endl;
+    return false;
+  }
+  TTree *tree=GetObject<TTree>(referenceFile,"Validation");
+  if (!tree) return false;
+  std::map<std::string,HistogramBinning> binning=HistogramBook::ReadBinning(configFile);
+  std::vector<std::string> names=GetScalarBranches(tree);
+  bool same=true;
+  for (const std::string &name : names)
+  {
+    TH1 *histogram=GetObject<TH1>(file,("Histograms/"+name).c_str());
+    std::vector<double> values;
+    if (!histogram) same=false;
+    if (!DrawValues(tree,name,values) || (Long64_t)values.size()!=tree->GetEntries())
+    {
+      std::cerr<<"Could not read "<<name<<" for every entry"<<std::endl;
+      same=false;
+    }
+    if (!histogram || (Long64_t)values.size()!=tree->GetEntries()) continue;
+    HistogramBinning thisBinning;
+    std::map<std::string,HistogramBinning>::const_iterator found=binning.find(name);
+    if (found!=binning.end()) thisBinning=found->second;
+    // Where the config doesn't give a number of bins, the output's is the module's default
+    int bins=(thisBinning.bins_>0 ? thisBinning.bins_ : histogram->GetNbinsX());
+    std::unique_ptr<TH1D> expected;
+    if (thisBinning.hasRange_)
+    {
+      expected.reset(new TH1D((name+"_expected").c_str(),"",bins,thisBinning.min_,thisBinning.max_));
+    }
+    else
+    {
+      expected.reset(new TH1D((name+"_expected").c_str(),"",bins,0,0));
+      expected->SetBuffer(warmupEvents);
+    }
+    expected->SetDirectory(nullptr);
+    for (double value : values) expected->Fill(value);
+    expected->BufferEmpty(1);
+    if (histogram->GetNbinsX()!=bins
+        || !SameValue(expected->GetXaxis()->GetXmin(),histogram->GetXaxis()->GetXmin())
+        || !SameValue(expected->GetXaxis()->GetXmax(),histogram->GetXaxis()->GetXmax()))
+    {
+      std::cerr<<"Histograms/"<<name<<" has "<<histogram->GetNbinsX()<<" bins from "<<histogram->GetXaxis()->GetXmin()
+               <<" to "<<histogram->GetXaxis()->GetXmax()<<", not "<<bins<<" from "<<expected->GetXaxis()->GetXmin()
+               <<" to "<<expected->GetXaxis()->GetXmax()<<std::endl;
+      same=false;
+      continue;
+    }
+    for (int bin=0;bin<=bins+1;++bin) // With the underflow and overflow
+    {
+      if (SameValue(expected->GetBinContent(bin),histogram->GetBinContent(bin))) continue;
+      std::cerr<<"Histograms/"<<name<<" bin "<<bin<<" is "<<histogram->GetBinContent(bin)<<", not "
+               <<expected->GetBinContent(bin)<<std::endl;
+      same=false;
+      break;
+    }
+  }
+  if (same) std::cout<<"flvalidate_check: "<<names.size()<<" histograms match "<<referenceFile.GetName()<<std::endl;
+  return same;
+}
+
+// RunSummary only has events with a header. Every event of the test file has one, so it has every
+// entry of the Validation tree, in runs that add up to the whole file
+bool CheckSummary(TFile &file, const std::string &name)
+{
+  TTree *tree=GetObject<TTree>(file,"Validation");
+  TTree *summary=GetObject<TTree>(file,"RunSummary");
+  if (!tree || !summary) return false;
+  std::vector<double> values, counts, sums, sumSquares, mins, maxes;
+  if (!DrawValues(tree,name,values) || (Long64_t)values.size()!=tree->GetEntries()
+      || !DrawValues(summary,"count",counts) || !DrawValues(summary,name+"_sum",sums)
+      || !DrawValues(summary,name+"_sum2",sumSquares) || !DrawValues(summary,name+"_min",mins)
+      || !DrawValues(summary,name+"_max",maxes) || counts.empty())
+  {
+    std::cerr<<"Could not read "<<name<<" from Validation and RunSummary"<<std::endl;
+    return false;
+  }
+  double count=0;
+  for (double runCount : counts) count+=runCount;
+  if (count!=tree->GetEntries())
+  {
+    std::cerr<<"RunSummary counts "<<count<<" events, but Validation has "<<tree->GetEntries()<<std::endl;
+    return false;
+  }
+  double expectedSum=0, expectedSumSquares=0;
+  for (double value : values)
+  {
+    expectedSum+=value;
+    expectedSumSquares+=value*value;
+  }
+  double sum=0, sumSquare=0;
+  for (size_t run=0;run<counts.size();++run)
+  {
+    sum+=sums[run];
+    sumSquare+=sumSquares[run];
+  }
+  double expectedMin=*std::min_element(values.begin(),values.end());
+  double expectedMax=*std::max_element(values.begin(),values.end());
+  double min=*std::min_element(mins.begin(),mins.end());
+  double max=*std::max_element(maxes.begin(),maxes.end());
+  bool same=true;
+  if (!SameValue(expectedSum,sum))
+  {
+    std::cerr<<"RunSummary."<<name<<"_sum adds up to "<<sum<<", not "<<expectedSum<<std::endl;
+    same=false;
+  }
+  if (!SameValue(expectedSumSquares,sumSquare))
+  {
+    std::cerr<<"RunSummary."<<name<<"_sum2 adds up to "<<sumSquare<<", not "<<expectedSumSquares<<std::endl;
+    same=false;
+  }
+  if (!SameValue(expectedMin,min) || !SameValue(expectedMax,max))
+  {
+    std::cerr<<"RunSummary."<<name<<" ranges from "<<min<<" to "<<max<<", not "<<expectedMin<<" to "<<expectedMax<<std::endl;
+    same=false;
+  }
+  if (same) std::cout<<"flvalidate_check: "<<counts.size()<<" run(s) of "<<count<<" events match the Validation tree"<<std::endl;
+  return same;
+}
+
+bool CheckTopology(TFile &file)
+{
+  TTree *tree=GetObject<TTree>(file,"Validation");
+  if (!tree) return false;
+  std::vector<double> topologies;
+  if (!DrawValues(tree,"event_topology",topologies) || (Long64_t)topologies.size()!=tree->GetEntries())
+  {
+    std::cerr<<"Could not read event_topology for every entry"<<std::endl;
+    return false;
+  }
+  bool same=true;
+  for (int topology=0;topology<TOPOLOGY_COUNT;++topology)
+  {
+    std::string name=std::string("topology_")+TOPOLOGY_NAMES[topology];
+    TEntryList *entries=GetObject<TEntryList>(file,name.c_str());
+    if (!entries)
+    {
+      same=false;
+      continue;
+    }
+    std::vector<Long64_t> expected;
+    for (Long64_t entry=0;entry<(Long64_t)topologies.size();++entry)
+    {
+      if ((unsigned int)topologies[entry] & (1u<<topology)) expected.push_back(entry);
+    }
+    std::vector<Long64_t> listed;
+    for (Long64_t i=0;i<entries->GetN();++i) listed.push_back(entries->GetEntry((int)i));
+    std::sort(listed.begin(),listed.end());
+    if (listed!=expected)
+    {
+      std::cerr<<name<<" has "<<listed.size()<<" entries, but "<<expected.size()<<" have the "<<TOPOLOGY_NAMES[topology]
+               <<" bit, or they aren't the same entries"<<std::endl;
+      same=false;
+    }
+  }
+  if (same) std::cout<<"flvalidate_check: the topology entry lists match event_topology for "<<topologies.size()<<" entries"<<std::endl;
+  return same;
+}
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc<3)
+  {
+    Usage();
+    return EXIT_FAILURE;
+  }
+  std::string check=argv[1];
+  std::unique_ptr<TFile> file(TFile::Open(argv[2],"READ"));
+  if (!file || file->IsZombie())
+  {
+    std::cerr<<"flvalidate_check: could not open "<<argv[2]<<std::endl;
+    return EXIT_FAILURE;
+  }
+  bool ok;
+  if (check=="detail" && argc==4) ok=CheckDetail(*file,std::atoll(argv[3]));
+  else if (check=="histograms" && argc==6)
+  {
+    std::unique_ptr<TFile> referenceFile(TFile::Open(argv[3],"READ"));
+    if (!referenceFile || referenceFile->IsZombie())
+    {
+      std::cerr<<"flvalidate_check: could not open "<<argv[3]<<std::endl;
+      return EXIT_FAILURE;
+    }
+    ok=CheckHistograms(*file,*referenceFile,argv[4],std::atoi(argv[5]));
+  }
+  else if (check=="summary" && argc==4) ok=CheckSummary(*file,argv[3]);
+  else if (check=="topology" && argc==3) ok=CheckTopology(*file);
+  else
+  {
+    Usage();
+    return EXIT_FAILURE;
+  }
+  return (ok ? EXIT_SUCCESS : EXIT_FAILURE);
+}
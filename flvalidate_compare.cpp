@@ -0,0 +1,303 @@
+// flvalidate_compare: check that two ValidationModule outputs have the same contents, as they should
+// for the same input however it was processed: by flreconstruct or flvalidate, in shards that were
+// merged, or resumed from a checkpoint. Everything in the reference file is compared with the object
+// of the same name in the other file: trees value by value, histograms bin by bin and entry lists
+// entry by entry. Values only need to agree to a relative 1e-9, as totals may have been added up in
+// a different order. Objects that are only in the other file, like a merged file's Shard tree, are
+// ignored. If the other output was rolling, its Validation tree is the chain of the files in its
+// index. Run without arguments for the options
+#include "TBranch.h"
+#include "TChain.h"
+#include "TDirectory.h"
+#include "TEntryList.h"
+#include "TFile.h"
+#include "TH1.h"
+#include "TKey.h"
+#include "TList.h"
+#include "TObjArray.h"
+#include "TTree.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+const double RELATIVE_TOLERANCE=1e-9;
+const int MAX_REPORTED=10; // Differences reported per object
+
+void Usage()
+{
+  std::cerr<<"Usage: flvalidate_compare [options] reference.root other.root"<<std::endl
+           <<"  -s NAME     skip objects with this name (can be repeated)"<<std::endl
+           <<"  -b PREFIX   only compare the Validation tree's branches that start with PREFIX, as when"<<std::endl
+           <<"              the other output only has some events' details"<<std::endl
+           <<"  -r INDEX    the other output was rolling: compare the reference's Validation tree with the"<<std::endl
+           <<"              chain of the files in this index (other_index.txt)"<<std::endl;
+}
+
+// Chain the Validation trees of the files in a rolling output's index, checking that each file has
+// the entries the index says, numbered on from the files before it
+bool ChainIndexFiles(const std::string &indexFile, TChain &chain)
+{
+  std::ifstream index(indexFile.c_str());
+  if (!index)
+  {
+    std::cerr<<"flvalidate_compare: could not read "<<indexFile<<std::endl;
+    return false;
+  }
+  Long64_t entries=0;
+  std::string line;
+  while (std::getline(index,line))
+  {
+    if (line.empty() || line[0]=='#') continue;
+    std::istringstream input(line);
+    std::string fileName;
+    Long64_t firstEntry, fileEntries;
+    if (!(input>>fileName>>firstEntry>>fileEntries))
+    {
+      std::cerr<<"flvalidate_compare: can't read the line \""<<line<<"\" of "<<indexFile<<std::endl;
+      return false;
+    }
+    std::unique_ptr<TFile> file(TFile::Open(fileName.c_str(),"READ"));
+    TTree *tree=nullptr;
+    if (file && !file->IsZombie()) file->GetObject("Validation",tree);
+    if (!tree)
+    {
+      std::cerr<<"flvalidate_compare: "<<fileName<<" has no Validation tree"<<std::endl;
+      return false;
+    }
+    if (firstEntry!=entries || tree->GetEntries()!=fileEntries)
+    {
+      std::cerr<<"flvalidate_compare: "<<fileName<<" has entries "<<entries<<" to "<<entries+tree->GetEntries()-1
+               <<", but the index says "<<firstEntry<<" to "<<firstEntry+fileEntries-1<<std::endl;
+      return false;
+    }
+    entries+=fileEntries;
+    chain.Add(fileName.c_str());
+  }
+  std::cout<<"flvalidate_compare: "<<chain.GetNtrees()<<" files with "<<entries<<" entries in "<<indexFile<<std::endl;
+  return true;
+}
+
+bool SameValue(double reference, double other)
+{
+  if (reference==other) return true;
+  return std::fabs(reference-other)<=RELATIVE_TOLERANCE*std::max(std::fabs(reference),std::fabs(other));
+}
+
+// The values of an expression for every entry, one after the other
+bool DrawValues(TTree *tree, const std::string &expression, std::vector<double> &values)
+{
+  values.clear();
+  tree->SetEstimate(tree->GetEntries()+1);
+  Long64_t rows=tree->Draw(expression.c_str(),"","goff");
+  if (rows<0) return false;
+  if (rows>tree->GetEstimate())
+  {
+    // Vector branches can have more values than entries
+    tree->SetEstimate(rows+1);
+    rows=tree->Draw(expression.c_str(),"","goff");
+  }
+  if (rows>0) values.assign(tree->GetV1(),tree->GetV1()+rows);
+  return true;
+}
+
+class Comparison{
+public:
+  // otherValidation, if given, is compared with the reference's Validation tree instead of the other file's
+  Comparison(const std::set<std::string> &skipped, TTree *otherValidation, const std::string &branchPrefix)
+    : skipped_(skipped), otherValidation_(otherValidation), branchPrefix_(branchPrefix) {}
+  // Returns false if anything is different
+  bool Compare(TDirectory *reference, TDirectory *other, const std::string &path);
+  int GetObjectCount() const { return objectCount_; }
+
+private:
+  const std::set<std::string> &skipped_;
+  TTree *otherValidation_;
+  std::string branchPrefix_; // For the Validation tree
+  int objectCount_=0;
+
+  bool CompareTrees(TTree *reference, TTree *other, const std::string &path);
+  bool CompareHistograms(TH1 *reference, TH1 *other, const std::string &path);
+  bool CompareEntryLists(TEntryList *reference, TEntryList *other, const std::string &path);
+};
+
+bool Comparison::Compare(TDirectory *reference, TDirectory *other, const std::string &path)
+{
+  bool same=true;
+  std::set<std::string> seen; // A tree saved several times has a key for each cycle: use the last
+  TIter next(reference->GetListOfKeys());
+  while (TKey *key=(TKey*)next())
+  {
+    std::string name=key->GetName();
+    if (!seen.insert(name).second || skipped_.count(name)) continue;
+    std::string objectPath=path+name;
+    TObject *referenceObject=reference->Get(name.c_str());
+    TObject *otherObject=(otherValidation_ && objectPath=="Validation" ? otherValidation_ : other->Get(name.c_str()));
+    if (!otherObject)
+    {
+      std::cerr<<objectPath<<" is missing"<<std::endl;
+      same=false;
+      continue;
+    }
+    ++objectCount_;
+    if (referenceObject->InheritsFrom(TDirectory::Class()))
+    {
+      if (!otherObject->InheritsFrom(TDirectory::Class())) same=false;
+      else same=Compare((TDirectory*)referenceObject,(TDirectory*)otherObject,objectPath+"/") && same;
+    }
+    else if (referenceObject->InheritsFrom(TTree::Class()))
+    {
+      if (!otherObject->InheritsFrom(TTree::Class())) same=false;
+      else same=CompareTrees((TTree*)referenceObject,(TTree*)otherObject,objectPath) && same;
+    }
+    else if (referenceObject->InheritsFrom(TH1::Class()))
+    {
+      if (!otherObject->InheritsFrom(TH1::Class())) same=false;
+      else same=CompareHistograms((TH1*)referenceObject,(TH1*)otherObject,objectPath) && same;
+    }
+    else if (referenceObject->InheritsFrom(TEntryList::Class()))
+    {
+      if (!otherObject->InheritsFrom(TEntryList::Class())) same=false;
+      else same=CompareEntryLists((TEntryList*)referenceObject,(TEntryList*)otherObject,objectPath) && same;
+    }
+  }
+  return same;
+}
+
+bool Comparison::CompareTrees(TTree *reference, TTree *other, const std::string &path)
+{
+  if (reference->GetEntries()!=other->GetEntries())
+  {
+    std::cerr<<path<<" has "<<other->GetEntries()<<" entries, not "<<reference->GetEntries()<<std::endl;
+    return false;
+  }
+  bool same=true;
+  TIter next(reference->GetListOfBranches());
+  while (TBranch *branch=(TBranch*)next())
+  {
+    std::string name=branch->GetName();
+    // Strings can't be drawn; they are only written with calo_string_ids, alongside the integers
+    if (std::string(branch->GetClassName()).find("string")!=std::string::npos) continue;
+    if (path=="Validation" && name.compare(0,branchPrefix_.size(),branchPrefix_)!=0) continue;
+    if (!other->GetBranch(name.c_str()))
+    {
+      std::cerr<<path<<" has no "<<name<<" branch"<<std::endl;
+      same=false;
+      continue;
+    }
+    std::vector<double> referenceValues, otherValues;
+    if (!DrawValues(reference,name,referenceValues) || !DrawValues(other,name,otherValues))
+    {
+      std::cerr<<"Could not read "<<path<<"."<<name<<std::endl;
+      same=false;
+      continue;
+    }
+    if (referenceValues.size()!=otherValues.size())
+    {
+      std::cerr<<path<<"."<<name<<" has "<<otherValues.size()<<" values, not "<<referenceValues.size()<<std::endl;
+      same=false;
+      continue;
+    }
+    int reported=0;
+    for (size_t i=0;i<referenceValues.size();++i)
+    {
+      if (SameValue(referenceValues[i],otherValues[i])) continue;
+      same=false;
+      if (++reported<=MAX_REPORTED)
+      {
+        std::cerr<<path<<"."<<name<<" value "<<i<<" is "<<otherValues[i]<<", not "<<referenceValues[i]<<std::endl;
+      }
+    }
+  }
+  return same;
+}
+
+bool Comparison::CompareHistograms(TH1 *reference, TH1 *other, const std::string &path)
+{
+  if (reference->GetNbinsX()!=other->GetNbinsX()
+      || !SameValue(reference->GetXaxis()->GetXmin(),other->GetXaxis()->GetXmin())
+      || !SameValue(reference->GetXaxis()->GetXmax(),other->GetXaxis()->GetXmax()))
+  {
+    std::cerr<<path<<" has different binning"<<std::endl;
+    return false;
+  }
+  bool same=true;
+  int reported=0;
+  for (int bin=0;bin<=reference->GetNbinsX()+1;++bin) // With the underflow and overflow
+  {
+    if (SameValue(reference->GetBinContent(bin),other->GetBinContent(bin))) continue;
+    same=false;
+    if (++reported<=MAX_REPORTED)
+    {
+      std::cerr<<path<<" bin "<<bin<<" is "<<other->GetBinContent(bin)<<", not "<<reference->GetBinContent(bin)<<std::endl;
+    }
+  }
+  return same;
+}
+
+bool Comparison::CompareEntryLists(TEntryList *reference, TEntryList *other, const std::string &path)
+{
+  if (reference->GetN()!=other->GetN())
+  {
+    std::cerr<<path<<" has "<<other->GetN()<<" entries, not "<<reference->GetN()<<std::endl;
+    return false;
+  }
+  for (Long64_t i=0;i<reference->GetN();++i)
+  {
+    if (reference->GetEntry((int)i)!=other->GetEntry((int)i))
+    {
+      std::cerr<<path<<" entry "<<i<<" is "<<other->GetEntry((int)i)<<", not "<<reference->GetEntry((int)i)<<std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+}
+
+int main(int argc, char *argv[])
+{
+  std::set<std::string> skipped;
+  std::string indexFile;
+  std::string branchPrefix;
+  std::vector<std::string> files;
+  for (int i=1;i<argc;i++)
+  {
+    std::string arg=argv[i];
+    bool hasValue=(i+1<argc);
+    if (arg=="-s" && hasValue) skipped.insert(argv[++i]);
+    else if (arg=="-r" && hasValue) indexFile=argv[++i];
+    else if (arg=="-b" && hasValue) branchPrefix=argv[++i];
+    else if (!arg.empty() && arg[0]!='-') files.push_back(arg);
+    else
+    {
+      Usage();
+      return EXIT_FAILURE;
+    }
+  }
+  if (files.size()!=2)
+  {
+    Usage();
+    return EXIT_FAILURE;
+  }
+  std::unique_ptr<TFile> reference(TFile::Open(files[0].c_str(),"READ"));
+  std::unique_ptr<TFile> other(TFile::Open(files[1].c_str(),"READ"));
+  if (!reference || reference->IsZombie() || !other || other->IsZombie())
+  {
+    std::cerr<<"flvalidate_compare: could not open the files"<<std::endl;
+    return EXIT_FAILURE;
+  }
+  TChain otherValidation("Validation");
+  if (!indexFile.empty() && !ChainIndexFiles(indexFile,otherValidation)) return EXIT_FAILURE;
+  Comparison comparison(skipped,(indexFile.empty() ? nullptr : &otherValidation),branchPrefix);
+  bool same=comparison.Compare(reference.get(),other.get(),"");
+  std::cout<<"flvalidate_compare: "<<comparison.GetObjectCount()<<" objects in "<<files[0]<<" are "
+           <<(same ? "the same" : "NOT the same")<<" in "<<files[1]<<std::endl;
+  return (same ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -0,0 +1,50 @@
+// flvalidate_merge: merge the outputs of ValidationModule jobs that each did a shard of the same
+// input (see shard_index and event_range), so that the result is the same as one job over all of it.
+// Run without arguments for the options
+#include "TROOT.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ValidationMerger.h"
+
+namespace {
+void Usage()
+{
+  std::cerr<<"Usage: flvalidate_merge -o merged.root [options] shard.root [shard.root ...]"<<std::endl
+           <<"  -o FILE     the merged output"<<std::endl
+           <<"  -j N        threads to merge on (default: one per core)"<<std::endl;
+}
+}
+
+int main(int argc, char *argv[])
+{
+  std::string outputFile;
+  int threads=(int)std::thread::hardware_concurrency();
+  std::vector<std::string> inputFiles;
+  for (int i=1;i<argc;i++)
+  {
+    std::string arg=argv[i];
+    bool hasValue=(i+1<argc);
+    if (arg=="-o" && hasValue) outputFile=argv[++i];
+    else if (arg=="-j" && hasValue) threads=std::atoi(argv[++i]);
+    else if (!arg.empty() && arg[0]!='-') inputFiles.push_back(arg);
+    else
+    {
+      Usage();
+      return EXIT_FAILURE;
+    }
+  }
+  if (outputFile.empty() || inputFiles.empty())
+  {
+    Usage();
+    return EXIT_FAILURE;
+  }
+  // Each thread merges its own files
+  ROOT::EnableThreadSafety();
+  ValidationMerger merger(threads);
+  return (merger.Merge(inputFiles,outputFile) ? EXIT_SUCCESS : EXIT_FAILURE);
+}